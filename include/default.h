@@ -17,4 +17,9 @@ using i64 = std::int64_t;
 #define MAX_HOMOLOGY_DIM_P1 4
 #define MAX_HOMOLOGY_DIM 3
 #define MAX_BARCODE_HOMOLOGY 2
-#define MAX_POINT_DIM 8
\ No newline at end of file
+#define MAX_POINT_DIM 8
+#define MEMORY_BUDGET_MB 8192
+
+// store filtration values as their (u32) rank among all edge values instead of as floats, so that they are compared
+// exactly and as integers, the ranks are mapped back to the values when the bars are output
+#define QUANTIZE_FILTRATION 0
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "trace.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+
+namespace detail {
+
+static inline size_t num_threads() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// size of the chunks that parallel_for splits a range of the given size into
+static inline size_t chunk_size(size_t size, size_t min_chunk = 1) {
+    const size_t threads = std::clamp<size_t>(size / std::max<size_t>(min_chunk, 1), 1, num_threads());
+    return std::max<size_t>((size + threads - 1) / threads, 1);
+}
+
+// number of chunks (and so threads) that parallel_for uses for a range of the given size
+static inline size_t num_chunks(size_t size, size_t min_chunk = 1) {
+    const size_t chunk = chunk_size(size, min_chunk);
+    return std::max<size_t>((size + chunk - 1) / chunk, 1);
+}
+
+/*
+ * Split [begin, end) into (at most) one contiguous chunk per hardware thread and call
+ * f(chunk_begin, chunk_end, chunk_index) for every chunk. The calling thread handles the first chunk.
+ * Small ranges (less than min_chunk elements per thread) are handled with fewer threads.
+ * */
+template<class Func>
+static void parallel_for(size_t begin, size_t end, Func&& f, size_t min_chunk = 1) {
+    if (end <= begin) {
+        return;
+    }
+    const size_t size = end - begin;
+    const size_t chunk = chunk_size(size, min_chunk);
+    const size_t chunks = num_chunks(size, min_chunk);
+
+    std::vector<std::thread> workers{};
+    workers.reserve(chunks - 1);
+    // the lanes of the workers follow the lane of this thread (see trace.h)
+    const int lane = trace::lane;
+    for (size_t t = 1; t < chunks; t++) {
+        const size_t chunk_begin = begin + t * chunk;
+        const size_t chunk_end = std::min(end, chunk_begin + chunk);
+        workers.emplace_back([&f, chunk_begin, chunk_end, t, lane] {
+            trace::lane = lane + t;
+            trace::Span span{"chunk"};
+            f(chunk_begin, chunk_end, t);
+        });
+    }
+    {
+        trace::Span span{"chunk"};
+        f(begin, std::min(end, begin + chunk), size_t{0});
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+}
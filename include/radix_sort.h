@@ -0,0 +1,82 @@
+#pragma once
+
+#include "parallel.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+
+namespace detail {
+
+// unsigned integer with the same order as the given (non-NaN) float
+static inline std::uint32_t radix_key(float value) {
+    const auto bits = std::bit_cast<std::uint32_t>(value);
+    // negative values have their order reversed, and should come before the positive ones
+    return bits & 0x8000'0000u ? ~bits : bits | 0x8000'0000u;
+}
+
+static inline std::uint32_t radix_key(std::uint32_t value) {
+    return value;
+}
+
+/*
+ * Stable LSD radix sort of data by the lowest key_bits bits of key(element), 8 bits per pass.
+ * Every pass counts the digits of one chunk per thread (the same chunks as parallel_for), after which every
+ * chunk knows where its elements of every digit go, and scatters them without synchronization.
+ * Passes in which all elements have the same digit are skipped.
+ * Since the sort is stable, sorting by a secondary key first and then by a primary key sorts by both.
+ * */
+template<class T, class Key>
+static void radix_sort(std::vector<T>& data, const Key& key, int key_bits) {
+    constexpr int digit_bits = 8;
+    constexpr size_t radix = size_t{1} << digit_bits;
+    constexpr size_t min_chunk = 1 << 16;
+
+    const size_t size = data.size();
+    const size_t chunks = num_chunks(size, min_chunk);
+    std::vector<std::array<size_t, radix>> offsets(chunks);
+    std::vector<T> buffer{};
+
+    for (int shift = 0; shift < key_bits; shift += digit_bits) {
+        auto digit = [&](const T& element) -> size_t {
+            return (key(element) >> shift) & (radix - 1);
+        };
+
+        parallel_for(0, size, [&](size_t begin, size_t end, size_t chunk) {
+            auto& counts = offsets[chunk];
+            counts.fill(0);
+            for (size_t i = begin; i < end; i++) {
+                counts[digit(data[i])]++;
+            }
+        }, min_chunk);
+
+        // offsets of every digit in every chunk, digits first so that the result is stable
+        size_t offset = 0;
+        bool trivial = false;
+        for (size_t d = 0; d < radix; d++) {
+            const size_t digit_begin = offset;
+            for (auto& counts : offsets) {
+                const size_t count = counts[d];
+                counts[d] = offset;
+                offset += count;
+            }
+            trivial |= offset - digit_begin == size;
+        }
+        if (trivial) {
+            continue;
+        }
+
+        buffer.resize(size);
+        parallel_for(0, size, [&](size_t begin, size_t end, size_t chunk) {
+            auto& next = offsets[chunk];
+            for (size_t i = begin; i < end; i++) {
+                buffer[next[digit(data[i])]++] = data[i];
+            }
+        }, min_chunk);
+        std::swap(data, buffer);
+    }
+}
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ios>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+/*
+ * Timeline of a run in the Chrome trace event format, which opens in chrome://tracing or the Perfetto UI (which both
+ * run locally, so no trace is uploaded anywhere). Spans (complete events) are recorded in the lane of their thread,
+ * counters (like the size of the simplex cache) get their own tracks. The workers of parallel_for take the lane of
+ * their chunk (after the lane of the thread that started them), so that a trace has as many lanes as the largest
+ * parallel_for, not one for every thread ever started. Threads that run alongside the main thread (like the workers of
+ * a Scheduler) start their own block of lanes, so that their spans never overlap those of another thread.
+ * Tracing is off unless Enable is called, until then every span or counter only checks trace::enabled.
+ * */
+
+namespace trace {
+
+inline std::atomic<bool> enabled = false;
+
+// lane of the current thread, 0 (main) unless it is a worker of parallel_for or started its own block of lanes
+inline thread_local int lane = 0;
+
+namespace detail {
+
+struct Event {
+    std::string name;
+    char phase;  // X for a span, C for a counter
+    double ts;  // in microseconds since Enable
+    double value;  // duration of a span, value of a counter
+    int lane;
+};
+
+inline std::mutex mutex{};
+inline std::vector<Event> events{};
+inline std::chrono::steady_clock::time_point start{};
+// amount of lanes that have events
+inline int lanes = 1;
+// names of the lanes that are not named after their chunk
+inline std::vector<std::pair<int, std::string>> names{};
+
+inline double Now() {
+    const std::chrono::duration<double, std::micro> duration = std::chrono::steady_clock::now() - start;
+    return duration.count();
+}
+
+inline void Record(Event event) {
+    std::lock_guard lock{mutex};
+    lanes = std::max(lanes, event.lane + 1);
+    events.push_back(std::move(event));
+}
+
+}
+
+// start recording (again)
+inline void Enable() {
+    std::lock_guard lock{detail::mutex};
+    detail::events.clear();
+    detail::lanes = 1;
+    detail::start = std::chrono::steady_clock::now();
+    enabled = true;
+}
+
+// name the lane of a thread in the trace, it is kept when recording starts again
+inline void NameLane(int lane, std::string name) {
+    std::lock_guard lock{detail::mutex};
+    detail::names.emplace_back(lane, std::move(name));
+}
+
+// record the time between its construction and destruction as a span on the lane of the current thread
+struct Span {
+    explicit Span(std::string_view name) {
+        if (enabled.load(std::memory_order_relaxed)) [[unlikely]] {
+            this->name = name;
+            start = detail::Now();
+            recording = true;
+        }
+    }
+
+    ~Span() {
+        if (recording) [[unlikely]] {
+            detail::Record({std::move(name), 'X', start, detail::Now() - start, lane});
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    std::string name{};
+    double start = 0;
+    bool recording = false;
+};
+
+// record the value of a counter track
+inline void Counter(std::string_view name, double value) {
+    if (enabled.load(std::memory_order_relaxed)) [[unlikely]] {
+        detail::Record({std::string{name}, 'C', detail::Now(), value, lane});
+    }
+}
+
+// write all events as a json trace, names are our own, so they never need escaping
+inline void Write(std::ostream& os) {
+    std::lock_guard lock{detail::mutex};
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed;
+    os.precision(3);
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    // only the lanes that have events, threads that start their own block of lanes leave gaps
+    std::vector<bool> used(detail::lanes, false);
+    used[0] = true;
+    for (const auto& event : detail::events) {
+        used[event.lane] = true;
+    }
+    for (int i = 0; i < detail::lanes; i++) {
+        if (!used[i]) continue;
+        std::string name = i ? "worker " + std::to_string(i) : "main";
+        for (const auto& [named, lane_name] : detail::names) {
+            if (named == i) name = lane_name;
+        }
+        os << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i
+           << ", \"args\": {\"name\": \"" << name << "\"}},\n";
+    }
+    for (const auto& [name, phase, ts, value, event_lane] : detail::events) {
+        os << "{\"name\": \"" << name << "\", \"ph\": \"" << phase << "\", \"pid\": 1, \"tid\": " << event_lane
+           << ", \"ts\": " << ts;
+        if (phase == 'X') {
+            os << ", \"dur\": " << value << "},\n";
+        }
+        else {
+            os << ", \"args\": {\"value\": " << value << "}},\n";
+        }
+    }
+    // the trace format allows a trailing comma, but not every viewer does
+    os << "{\"name\": \"end\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": " << detail::Now() << "}\n";
+    os << "]}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}
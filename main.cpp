@@ -1,9 +1,23 @@
 #include "frontend/frontend.h"
 #include "compute/reader.h"
+#include "compute/witness.h"
+#include "compute/alpha.h"
+#include "compute/graph.h"
+#include "compute/metric.h"
+#include "compute/stats.h"
+#include "compute/perf.h"
+#include "benchmark/benchmark.h"
+#include "trace.h"
 
+#include <array>
+#include <cmath>
 #include <memory>
+#include <span>
 #include <fstream>
+#include <iostream>
+#include <optional>
 #include <string>
+#include <vector>
 #include <algorithm>
 
 
@@ -16,19 +30,182 @@
 enum class Mode {
     Frontend,
     Barcode,
-    Benchmark,
-    Testing,
+    Witness,
+    Alpha,
 };
 
 
-int main(int argc, char** argv) {
+// stages and counters of the whole run, written as json with --stats
+static Stats stats{};
+
+static void WriteBarcode(ComputeBase& compute, float upper_bound, const std::string& output_file) {
+    std::array<std::vector<std::pair<float, float>>, MAX_BARCODE_HOMOLOGY + 1> barcode;
+    try {
+        StageTimer timer{stats, "barcode"};
+        barcode = compute.FindBarcode(upper_bound);
+    }
+    catch (BudgetExceeded& e) {
+        std::printf("%s\n", e.what());
+        exit(1);
+    }
+    stats.Merge(compute.stats);
+
+    StageTimer timer{stats, "write"};
+    std::ofstream csv(output_file);
+    csv << "homology dimension,start,end" << std::endl;
+
+    for (int dim = 0; dim < barcode.size(); dim++) {
+        for (const auto [start, end] : barcode[dim]) {
+            csv << dim << "," << start << "," << end << std::endl;
+        }
+    }
+}
+
+static double ParseBarcodeEnd(const char* arg) {
+    try {
+        return std::stod(arg);
+    }
+    catch (std::logic_error&) {
+        std::printf("Could not parse barcode end, please enter valid floating point values\n");
+        exit(1);
+    }
+}
+
+
+static bool HasOption(const std::vector<std::string>& options, const std::string& option) {
+    return std::find(options.begin(), options.end(), option) != options.end();
+}
+
+// value of an option given as --option=value, or the default if it is not given
+static std::string OptionValue(const std::vector<std::string>& options, const std::string& option, const std::string& default_value) {
+    for (const auto& o : options) {
+        if (o.starts_with(option + "=")) return o.substr(option.size() + 1);
+    }
+    return default_value;
+}
+
+// --trace=<file> writes a trace of the run to a file, see trace.h
+static void WriteTrace(const std::vector<std::string>& options) {
+    const std::string trace_file = OptionValue(options, "--trace", "");
+    if (!trace_file.empty()) {
+        std::ofstream json(trace_file);
+        trace::Write(json);
+    }
+}
+
+// --stats writes the stats to stdout, --stats=<file> to a file
+static void WriteStats(const std::vector<std::string>& options) {
+    if (HasOption(options, "--stats")) {
+        stats.WriteJson(std::cout);
+        return;
+    }
+    const std::string stats_file = OptionValue(options, "--stats", "");
+    if (!stats_file.empty()) {
+        std::ofstream json(stats_file);
+        stats.WriteJson(json);
+    }
+}
+
+
+int main(int _argc, char** _argv) {
+    // options (--option) may be given anywhere, the remaining arguments are positional
+    std::vector<std::string> options{};
+    std::vector<char*> args{};
+    for (int i = 0; i < _argc; i++) {
+        if (i > 0 && std::string{_argv[i]}.starts_with("--")) options.emplace_back(_argv[i]);
+        else args.push_back(_argv[i]);
+    }
+    const int argc = args.size();
+    char** argv = args.data();
+
     if (argc == 1) {
       std::printf("Please enter a file with points\n");
       exit(1);
     }
+
+    // the benchmark generates its own points
+    if (std::string{argv[1]} == "benchmark") {
+        if (argc < 3) {
+            std::printf("Please enter an output file for the benchmark results\n");
+            exit(1);
+        }
+        try {
+            RunBenchmark(ParseBenchmarkOptions(options), argv[2]);
+        }
+        catch (std::runtime_error& e) {
+            std::printf("%s\n", e.what());
+            exit(1);
+        }
+        return 0;
+    }
+
+    if (!OptionValue(options, "--trace", "").empty()) {
+        trace::Enable();
+    }
+    if (HasOption(options, "--perf")) {
+        const std::string error = perf::Enable();
+        if (!error.empty()) {
+            std::printf("Hardware counters are not available, only timing the stages: %s\n", error.c_str());
+        }
+    }
+
     auto reader = std::make_unique<Reader>(argv[1]);
-    auto points = reader->Read();
-    auto compute = std::make_unique<Compute<MAX_POINTS>>(points);
+
+    // the input is either points, or the distances between points that we have no coordinates for
+    const std::string input = OptionValue(options, "--input", "points");
+    std::span<const point_max> points{};
+    std::vector<point_max> placeholder_points{};
+    std::vector<float> distances{};
+    std::unique_ptr<Graph> graph{};
+    std::optional<StageTimer> read_timer{std::in_place, stats, "read"};
+    if (input == "points") {
+        points = reader->Read();
+    }
+    else if (input == "matrix" || input == "edges") {
+        size_t count;
+        if (input == "matrix") {
+            distances = reader->ReadDistanceMatrix();
+            count = std::lround(std::sqrt(distances.size()));
+            // Compute works with squared distances
+            for (auto& distance : distances) {
+                distance *= distance;
+            }
+        }
+        else {
+            graph = std::make_unique<Graph>(reader->ReadEdges());
+            count = graph->vertices;
+        }
+        if (count > MAX_POINTS) {
+            std::printf("Distance inputs support at most %d points, got %zu\n", MAX_POINTS, count);
+            exit(1);
+        }
+        placeholder_points.resize(count);
+        points = placeholder_points;
+    }
+    else {
+        std::printf("Please enter a valid input (points, matrix or edges), got %s\n", input.c_str());
+        exit(1);
+    }
+    read_timer.reset();
+
+    Metric metric;
+    try {
+        metric = ParseMetric(OptionValue(options, "--metric", "euclidean"));
+    }
+    catch (std::runtime_error& e) {
+        std::printf("%s\n", e.what());
+        exit(1);
+    }
+    if (metric != Metric::Euclidean && input != "points") {
+        std::printf("Metrics can only be used for points, not for distance inputs\n");
+        exit(1);
+    }
+
+    const bool collapse_edges = HasOption(options, "--collapse");
+    const size_t memory_budget = std::strtoull(
+            OptionValue(options, "--memory-budget", std::to_string(MEMORY_BUDGET_MB)).c_str(), nullptr, 10
+    ) << 20;
+
     Mode mode;
     if (argc == 2) {
         mode = Mode::Frontend;
@@ -38,14 +215,46 @@ int main(int argc, char** argv) {
         std::transform(mode_string.begin(), mode_string.end(), mode_string.begin(), [](char c) { return std::tolower(c); });
         if (mode_string == "frontend") mode = Mode::Frontend;
         else if (mode_string == "barcode") mode = Mode::Barcode;
+        else if (mode_string == "witness") mode = Mode::Witness;
+        else if (mode_string == "alpha") mode = Mode::Alpha;
         else {
-           std::printf("Please enter a valid mode (frontend or barcode), got %s\n", argv[2]);
+           std::printf("Please enter a valid mode (frontend, barcode, witness or alpha), got %s\n", argv[2]);
            exit(1);
         }
     }
 
+    if (input != "points" && mode != Mode::Barcode) {
+        std::printf("Only the barcode mode supports distance inputs, the other modes need the coordinates of the points\n");
+        exit(1);
+    }
+    if (collapse_edges && (graph || mode == Mode::Alpha)) {
+        // the simplices of a graph or an alpha complex are all given, so there are no edges to collapse before finding them
+        std::printf("--collapse only works for the Vietoris Rips complex of points or a distance matrix\n");
+        exit(1);
+    }
+
+    // the Vietoris Rips complex of all points, which holds the (dense) values of all their edges
+    // only the frontend and barcode modes use it, the other modes build their own (smaller) complex
+    auto rips_compute = [&] {
+        if (points.size() > MAX_POINTS) {
+            std::printf("The Vietoris Rips complex supports at most %d points, got %zu\n", MAX_POINTS, points.size());
+            exit(1);
+        }
+        if (metric != Metric::Euclidean) {
+            distances = FindDistanceMatrix(points, metric);
+        }
+
+        StageTimer timer{stats, "edges"};
+        auto compute = distances.empty()
+                ? std::make_unique<Compute<MAX_POINTS>>(points)
+                : std::make_unique<Compute<MAX_POINTS>>(points, std::move(distances));
+        compute->collapse_edges = collapse_edges;
+        compute->memory_budget = memory_budget;
+        return compute;
+    };
+
     if (mode == Mode::Frontend) {
-        auto frontend = std::make_unique<Frontend>(std::move(compute));
+        auto frontend = std::make_unique<Frontend>(rips_compute());
 
         frontend->Run();
     }
@@ -54,47 +263,108 @@ int main(int argc, char** argv) {
             std::printf("Please enter valid parameters for the barcode (end, output_file), got %d parameters\n", argc);
             exit(1);
         }
-        double end;
-        try {
-            end = std::stod(argv[3]);
+        double end = ParseBarcodeEnd(argv[3]);
+        std::string output_file = argv[4];
+
+        if (graph) {
+            // the simplices of a sparse graph are found from its cliques right away, up to the end of the barcode
+            try {
+                Compute<MAX_POINTS>::Admit(*graph, end, MAX_HOMOLOGY_DIM, memory_budget);
+            }
+            catch (BudgetExceeded& e) {
+                std::printf("%s\n", e.what());
+                exit(1);
+            }
+            auto graph_compute = std::make_unique<Compute<MAX_POINTS>>(points, graph->FindFiltration(end));
+            WriteBarcode(*graph_compute, end, output_file);
         }
-        catch (std::out_of_range) {
-            std::printf("Could not parse barcode end, please enter valid floating point values\n");
+        else {
+            WriteBarcode(*rips_compute(), end, output_file);
+        }
+    }
+    else if (mode == Mode::Witness) {
+        if (argc < 6) {
+            std::printf("Please enter valid parameters for the witness barcode (end, output_file, landmarks, [maxmin|random], [nu]), got %d parameters\n", argc);
             exit(1);
         }
+        double end = ParseBarcodeEnd(argv[3]);
         std::string output_file = argv[4];
+        size_t num_landmarks = std::strtoul(argv[5], nullptr, 10);
+        if (num_landmarks == 0 || num_landmarks > MAX_POINTS) {
+            std::printf("Please enter a number of landmarks between 1 and %d, got %s\n", MAX_POINTS, argv[5]);
+            exit(1);
+        }
 
-        auto barcode = compute->FindBarcode(end);
-        std::ofstream csv(output_file);
-        csv << "homology dimension,start,end" << std::endl;
-
-        for (int dim = 0; dim < barcode.size(); dim++) {
-            for (const auto [start, end] : barcode[dim]) {
-                csv << dim << "," << start << "," << end << std::endl;
+        auto method = Witness::Landmarks::MaxMin;
+        if (argc > 6) {
+            std::string method_string{argv[6]};
+            if (method_string == "random") method = Witness::Landmarks::Random;
+            else if (method_string != "maxmin") {
+                std::printf("Please enter a valid landmark selection method (maxmin or random), got %s\n", argv[6]);
+                exit(1);
             }
         }
+        int nu = argc > 7 ? std::atoi(argv[7]) : 1;
+
+        // the Mahalanobis distance is the euclidean distance between whitened points
+        std::vector<point_max> whitened{};
+        if (metric == Metric::Mahalanobis) {
+            whitened = Whiten(points);
+        }
+        std::optional<StageTimer> witness_timer{std::in_place, stats, "witness"};
+        Witness witness{whitened.empty() ? points : std::span<const point_max>{whitened}, metric};
+        auto landmarks = witness.SelectLandmarks(num_landmarks, method);
+        auto distances = witness.FindLazyWitnessDistances(landmarks, nu, end);
+        witness_timer.reset();
+
+        std::vector<point_max> landmark_points{};
+        landmark_points.reserve(landmarks.size());
+        for (auto landmark : landmarks) {
+            landmark_points.push_back(points[landmark]);
+        }
+
+        auto witness_compute = std::make_unique<Compute<MAX_POINTS>>(landmark_points, std::move(distances));
+        witness_compute->collapse_edges = collapse_edges;
+        witness_compute->memory_budget = memory_budget;
+        WriteBarcode(*witness_compute, end, output_file);
     }
-    else if (mode == Mode::Benchmark) {
-        // manual benchmark
-//        constexpr size_t dim = 3;
-//        auto fut = std::async(std::launch::async, &ComputeBase::FindHBasisDrawIndices, compute.get(), 1.6, 2);
-//        auto start = std::chrono::steady_clock::now();
-//        while (fut.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
-//            std::printf("%d\n", compute->current_simplices);
-//            std::this_thread::sleep_for(std::chrono::milliseconds(60));
-//        }
-//        auto result = fut.get();
-//        auto duration = std::chrono::steady_clock::now() - start;
-//        std::printf("\n\n");
-//        std::printf("%lldms\n", std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
-//        std::printf("%llu basis vectors\n", result.first);
-
-        // for AMD uProf
-        auto [dim, _] = compute->FindHBasisDrawIndices(0.2, 2);
-        std::printf("%lld\n", dim);
-    }
-    else {
-        compute->FindHBasisDrawIndices(0.2, 1);
+    else if (mode == Mode::Alpha) {
+        if (argc < 5) {
+            std::printf("Please enter valid parameters for the alpha barcode (end, output_file, [2|3]), got %d parameters\n", argc);
+            exit(1);
+        }
+        double end = ParseBarcodeEnd(argv[3]);
+        std::string output_file = argv[4];
+        int dim = argc > 5 ? std::atoi(argv[5]) : 3;
+        if (dim != 2 && dim != 3) {
+            std::printf("Please enter a valid alpha complex dimension (2 or 3), got %s\n", argv[5]);
+            exit(1);
+        }
+        if (points.size() > MAX_POINTS) {
+            std::printf("The alpha complex supports at most %d points, got %zu\n", MAX_POINTS, points.size());
+            exit(1);
+        }
+        if (metric != Metric::Euclidean) {
+            std::printf("The alpha complex only exists for the euclidean distance\n");
+            exit(1);
+        }
+
+        std::optional<StageTimer> alpha_timer{std::in_place, stats, "alpha"};
+        Alpha alpha{points, dim};
+        Filtration filtration;
+        try {
+            filtration = alpha.FindFiltration();
+        }
+        catch (std::runtime_error& e) {
+            // for example points that all lie on a line
+            std::printf("%s\n", e.what());
+            exit(1);
+        }
+        auto alpha_compute = std::make_unique<Compute<MAX_POINTS>>(points, filtration);
+        alpha_timer.reset();
+        WriteBarcode(*alpha_compute, end, output_file);
     }
+    WriteStats(options);
+    WriteTrace(options);
     return 0;
 }
@@ -0,0 +1,186 @@
+#include "benchmark.h"
+
+#include "compute/compute.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace {
+
+std::vector<std::string> SplitList(const std::string& list) {
+    std::vector<std::string> result{};
+    std::stringstream stream{list};
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) result.push_back(item);
+    }
+    return result;
+}
+
+template<typename T, class F>
+std::vector<T> ParseList(const std::string& option, const std::string& list, const F& parse) {
+    std::vector<T> result{};
+    for (const auto& item : SplitList(list)) {
+        try {
+            result.push_back(parse(item));
+        }
+        catch (std::logic_error&) {
+            throw std::runtime_error("Invalid value " + item + " for " + option);
+        }
+    }
+    if (result.empty()) {
+        throw std::runtime_error("Please give at least one value for " + option);
+    }
+    return result;
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    return duration.count();
+}
+
+}
+
+BenchmarkOptions ParseBenchmarkOptions(const std::vector<std::string>& options) {
+    BenchmarkOptions result{};
+    for (const auto& option : options) {
+        const auto separator = option.find('=');
+        const std::string name = option.substr(0, separator);
+        const std::string value = separator == std::string::npos ? "" : option.substr(separator + 1);
+        try {
+            if (name == "--shapes") {
+                result.shapes = ParseList<Shape>(name, value, ParseShape);
+            }
+            else if (name == "--dims") {
+                result.dims = ParseList<int>(name, value, [](const std::string& s) { return std::stoi(s); });
+            }
+            else if (name == "--sizes") {
+                result.sizes = ParseList<size_t>(name, value, [](const std::string& s) { return std::stoul(s); });
+            }
+            else if (name == "--epsilons") {
+                result.epsilons = ParseList<float>(name, value, [](const std::string& s) { return std::stof(s); });
+            }
+            else if (name == "--runs") {
+                result.runs = std::stoi(value);
+            }
+            else if (name == "--seed") {
+                result.seed = std::stoull(value);
+            }
+            else if (name == "--noise") {
+                result.noise = std::stof(value);
+            }
+            else if (name == "--collapse") {
+                result.collapse_edges = true;
+            }
+            else if (name == "--memory-budget") {
+                result.memory_budget = std::stoull(value) << 20;
+            }
+            else {
+                throw std::runtime_error("Unknown benchmark option " + option);
+            }
+        }
+        catch (std::logic_error&) {
+            throw std::runtime_error("Invalid value " + value + " for " + name);
+        }
+    }
+
+    if (result.runs < 1) {
+        throw std::runtime_error("Please enter at least 1 run");
+    }
+    for (const auto size : result.sizes) {
+        if (size == 0 || size > MAX_POINTS) {
+            throw std::runtime_error("Benchmark sizes must be between 1 and " + std::to_string(MAX_POINTS));
+        }
+    }
+    for (const auto dim : result.dims) {
+        if (dim < 1 || dim > MAX_POINT_DIM) {
+            throw std::runtime_error("Benchmark dimensions must be between 1 and " + std::to_string(MAX_POINT_DIM));
+        }
+    }
+    return result;
+}
+
+void RunBenchmark(const BenchmarkOptions& options, const std::string& output_file) {
+    std::ofstream csv(output_file);
+    if (!csv) {
+        throw std::runtime_error("Could not open " + output_file);
+    }
+    csv << "shape,dim,points,epsilon,run,stage,seconds,simplices,bars" << std::endl;
+    std::printf("%zu threads, seed %llu\n", detail::num_threads(), (unsigned long long)options.seed);
+
+    for (const auto shape : options.shapes) {
+        // the torus and the Swiss roll have a fixed dimension, so we only run them once
+        std::vector<int> dims{};
+        for (const auto dim : options.dims) {
+            const int shape_dim = ShapeDimension(shape, dim);
+            if (std::find(dims.begin(), dims.end(), shape_dim) == dims.end()) dims.push_back(shape_dim);
+        }
+
+        for (const auto dim : dims) {
+            for (const auto size : options.sizes) {
+                for (const auto epsilon : options.epsilons) {
+                    std::vector<double> totals{};
+                    size_t simplices = 0, bars = 0;
+                    std::string skipped{};
+
+                    for (int run = 0; run < options.runs; run++) {
+                        std::vector<std::pair<std::string, double>> stages{};
+
+                        auto start = std::chrono::steady_clock::now();
+                        const auto points = Generate(shape, size, dim, options.seed, options.noise);
+                        stages.emplace_back("generate", Seconds(start));
+
+                        start = std::chrono::steady_clock::now();
+                        auto compute = std::make_unique<Compute<MAX_POINTS>>(points);
+                        stages.emplace_back("edges", Seconds(start));
+                        compute->collapse_edges = options.collapse_edges;
+                        compute->memory_budget = options.memory_budget;
+
+                        start = std::chrono::steady_clock::now();
+                        try {
+                            const auto barcode = compute->FindBarcode(epsilon);
+                            const double seconds = Seconds(start);
+                            for (const auto& stage : compute->stats.stages) {
+                                stages.emplace_back(stage.name, stage.seconds);
+                            }
+                            stages.emplace_back("barcode", seconds);
+
+                            simplices = points.size();
+                            for (const auto& cache : compute->cache) simplices += cache.Load().size();
+                            bars = 0;
+                            for (const auto& bars_n : barcode) bars += bars_n.size();
+                            totals.push_back(stages[1].second + seconds);
+                        }
+                        catch (BudgetExceeded& e) {
+                            skipped = e.what();
+                            csv << ShapeName(shape) << "," << dim << "," << size << "," << epsilon << ","
+                                << run << ",skipped,,," << std::endl;
+                            break;
+                        }
+
+                        for (const auto& [stage, seconds] : stages) {
+                            csv << ShapeName(shape) << "," << dim << "," << size << "," << epsilon << ","
+                                << run << "," << stage << "," << seconds << "," << simplices << "," << bars << std::endl;
+                        }
+                    }
+
+                    if (!skipped.empty()) {
+                        std::printf("%-10s dim %d, %4zu points, epsilon %.3f: skipped, %s\n",
+                                    ShapeName(shape), dim, size, epsilon, skipped.c_str());
+                        continue;
+                    }
+                    std::sort(totals.begin(), totals.end());
+                    std::printf("%-10s dim %d, %4zu points, epsilon %.3f: %9.2f ms, %zu simplices, %zu bars\n",
+                                ShapeName(shape), dim, size, epsilon, 1000 * totals[totals.size() / 2], simplices, bars);
+                }
+            }
+        }
+    }
+}
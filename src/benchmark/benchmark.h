@@ -0,0 +1,37 @@
+#pragma once
+
+#include "datagen.h"
+#include "default.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * Benchmark of the barcode pipeline on synthetic point clouds (see datagen.h). Every combination of shape, dimension,
+ * size and epsilon is run a number of times, each time on a fresh Compute, so that nothing is cached between runs.
+ * The wall time of every stage of every run is written to a csv file with the columns
+ *     shape,dim,points,epsilon,run,stage,seconds,simplices,bars
+ * where the stages are generate, edges (constructing Compute), the stages of FindBarcode (Compute::stats) and
+ * barcode (all of FindBarcode). Runs that exceed the memory budget get a single row with stage skipped.
+ * A summary (median over the runs) is printed as well.
+ * */
+
+struct BenchmarkOptions {
+    std::vector<Shape> shapes{Shape::Sphere, Shape::Torus, Shape::Gaussians, Shape::Cube, Shape::SwissRoll};
+    // ignored for the torus and the Swiss roll, which are always 3 dimensional
+    std::vector<int> dims{3};
+    std::vector<size_t> sizes{128, 256, 512};
+    std::vector<float> epsilons{0.05, 0.1, 0.15};
+    int runs = 3;
+    u64 seed = 0;
+    float noise = 0;
+    bool collapse_edges = false;
+    size_t memory_budget = size_t{MEMORY_BUDGET_MB} << 20;
+};
+
+// parse --shapes=, --dims=, --sizes=, --epsilons= (comma separated lists), --runs=, --seed=, --noise=, --collapse and
+// --memory-budget= (in MB), throws std::runtime_error for invalid values
+BenchmarkOptions ParseBenchmarkOptions(const std::vector<std::string>& options);
+
+// run the benchmark and write the timings to output_file
+void RunBenchmark(const BenchmarkOptions& options, const std::string& output_file);
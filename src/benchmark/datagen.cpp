@@ -0,0 +1,128 @@
+#include "datagen.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+
+
+namespace {
+
+struct Random {
+    explicit Random(u64 seed) : engine(seed) {
+
+    }
+
+    // uniform in [0, 1)
+    double Uniform() {
+        return (engine() >> 11) * 0x1.0p-53;
+    }
+
+    double Uniform(double low, double high) {
+        return low + (high - low) * Uniform();
+    }
+
+    // standard normal (Box-Muller)
+    double Normal() {
+        const double u = 1 - Uniform();  // in (0, 1], so that the log is finite
+        const double v = Uniform();
+        return std::sqrt(-2 * std::log(u)) * std::cos(2 * std::numbers::pi * v);
+    }
+
+    std::mt19937_64 engine;
+};
+
+}
+
+Shape ParseShape(const std::string& name) {
+    if (name == "sphere") return Shape::Sphere;
+    if (name == "torus") return Shape::Torus;
+    if (name == "gaussians") return Shape::Gaussians;
+    if (name == "cube") return Shape::Cube;
+    if (name == "swissroll") return Shape::SwissRoll;
+    throw std::runtime_error("Unknown shape " + name + " (sphere, torus, gaussians, cube or swissroll)");
+}
+
+const char* ShapeName(Shape shape) {
+    switch (shape) {
+        case Shape::Sphere: return "sphere";
+        case Shape::Torus: return "torus";
+        case Shape::Gaussians: return "gaussians";
+        case Shape::Cube: return "cube";
+        case Shape::SwissRoll: return "swissroll";
+    }
+    return "unknown";
+}
+
+int ShapeDimension(Shape shape, int dim) {
+    if (shape == Shape::Torus || shape == Shape::SwissRoll) {
+        return 3;
+    }
+    return dim;
+}
+
+std::vector<point_max> Generate(Shape shape, size_t count, int dim, u64 seed, float noise) {
+    dim = ShapeDimension(shape, dim);
+    if (dim < 1 || dim > MAX_POINT_DIM) {
+        throw std::runtime_error("Points can have 1 to " + std::to_string(MAX_POINT_DIM) + " coordinates, got " + std::to_string(dim));
+    }
+
+    Random random{seed};
+    constexpr double pi = std::numbers::pi;
+    constexpr int clusters = 4;
+    std::array<std::array<double, MAX_POINT_DIM>, clusters> centers{};
+    if (shape == Shape::Gaussians) {
+        for (auto& center : centers) {
+            for (int c = 0; c < dim; c++) center[c] = random.Uniform(-1, 1);
+        }
+    }
+
+    std::vector<point_max> points(count);
+    for (auto& p : points) {
+        switch (shape) {
+            case Shape::Sphere: {
+                double norm = 0;
+                while (norm == 0) {
+                    for (int c = 0; c < dim; c++) {
+                        p[c] = random.Normal();
+                        norm += p[c] * p[c];
+                    }
+                }
+                for (int c = 0; c < dim; c++) p[c] /= std::sqrt(norm);
+                break;
+            }
+            case Shape::Torus: {
+                constexpr double R = 1, r = 0.3;
+                const double phi = random.Uniform(0, 2 * pi);
+                const double theta = random.Uniform(0, 2 * pi);
+                p[0] = (R + r * std::cos(theta)) * std::cos(phi);
+                p[1] = (R + r * std::cos(theta)) * std::sin(phi);
+                p[2] = r * std::sin(theta);
+                break;
+            }
+            case Shape::Gaussians: {
+                const auto& center = centers[std::min<int>(random.Uniform() * clusters, clusters - 1)];
+                for (int c = 0; c < dim; c++) p[c] = center[c] + 0.25 * random.Normal();
+                break;
+            }
+            case Shape::Cube: {
+                for (int c = 0; c < dim; c++) p[c] = random.Uniform(-1, 1);
+                break;
+            }
+            case Shape::SwissRoll: {
+                const double t = 1.5 * pi * (1 + 2 * random.Uniform());
+                const double height = random.Uniform(-1, 1);
+                p[0] = t * std::cos(t) / 15;
+                p[1] = height;
+                p[2] = t * std::sin(t) / 15;
+                break;
+            }
+        }
+        if (noise > 0) {
+            for (int c = 0; c < dim; c++) p[c] += noise * random.Normal();
+        }
+    }
+    return points;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "compute/point.h"
+#include "default.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * Deterministic synthetic point clouds for benchmarking. The same shape, size, dimension and seed always give the
+ * same points. The random numbers come from std::mt19937_64 (whose output is fixed by the standard), and are turned
+ * into uniform and normal values here instead of through the standard distributions (which differ between standard
+ * libraries), so other platforms only differ in the rounding of std::sin, std::log etc.
+ * */
+
+enum class Shape {
+    Sphere,
+    Torus,
+    Gaussians,
+    Cube,
+    SwissRoll,
+};
+
+// parse the name of a shape (sphere, torus, gaussians, cube or swissroll)
+Shape ParseShape(const std::string& name);
+
+const char* ShapeName(Shape shape);
+
+// dimension of the points of a shape, the torus and the Swiss roll always lie in 3 dimensions
+int ShapeDimension(Shape shape, int dim);
+
+/*
+ * Generate count points of a shape, the shapes are all about 2 units across:
+ *  - sphere: uniform on the unit sphere in dim dimensions
+ *  - torus: uniform angles on a torus with radii 1 and 0.3
+ *  - gaussians: 4 clusters with standard deviation 0.25 around random centers in [-1, 1]^dim
+ *  - cube: uniform in [-1, 1]^dim
+ *  - swissroll: a rolled up rectangle, scaled down to about [-1, 1]^3
+ * noise adds normally distributed noise with that standard deviation to every coordinate.
+ * */
+std::vector<point_max> Generate(Shape shape, size_t count, int dim, u64 seed, float noise = 0);
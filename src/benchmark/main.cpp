@@ -0,0 +1,34 @@
+#include "benchmark.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+/*
+ * The benchmark on its own, without the frontend (so without SDL2 and OpenGL), see benchmark.h.
+ * Usage: SimplexBenchmark output_file [--shapes=...] [--dims=...] [--sizes=...] [--epsilons=...] [--runs=...] ...
+ * */
+
+int main(int argc, char** argv) {
+    std::vector<std::string> options{};
+    std::vector<std::string> args{};
+    for (int i = 1; i < argc; i++) {
+        if (std::string{argv[i]}.starts_with("--")) options.emplace_back(argv[i]);
+        else args.emplace_back(argv[i]);
+    }
+    if (args.empty()) {
+        std::printf("Please enter an output file for the benchmark results\n");
+        return 1;
+    }
+
+    try {
+        RunBenchmark(ParseBenchmarkOptions(options), args[0]);
+    }
+    catch (std::runtime_error& e) {
+        std::printf("%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
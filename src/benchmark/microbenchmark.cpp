@@ -0,0 +1,271 @@
+#include "compute/simplex.h"
+#include "compute/column.h"
+#include "default.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+
+/*
+ * Microbenchmarks of the building blocks of the reduction: the operations on Simplex and Column and hash_value,
+ * for a few sizes of simplices. Every benchmark cycles through a set of random inputs (so that branches can not be
+ * learned for a single input), and is repeated until it ran for at least --min-time seconds. It reports the time and
+ * the number of heap allocations (counted by replacing the global operator new) per operation.
+ * The inputs resemble the ones in an actual reduction: simplices have 2 to 4 points (edges up to tetrahedra) and
+ * columns hold simplices of 3 points, two columns that are added share about half of their entries.
+ * Usage: SimplexMicrobenchmark [output_file] [--filter=...] [--min-time=...]
+ * where output_file is a csv file with the columns benchmark,ns_per_op,allocations_per_op, and only benchmarks
+ * with the filter in their name are run.
+ * */
+
+namespace {
+
+std::atomic<u64> allocations = 0;
+
+void* Allocate(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(std::max<size_t>(size, 1))) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* AllocateAligned(size_t size, std::align_val_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+    void* p = _aligned_malloc(std::max<size_t>(size, 1), align);
+#else
+    // aligned_alloc wants a size that is a multiple of the alignment
+    void* p = std::aligned_alloc(align, std::max<size_t>((size + align - 1) / align * align, align));
+#endif
+    if (p) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void FreeAligned(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+
+
+namespace {
+
+// amount of different inputs every benchmark cycles through, a power of 2
+constexpr size_t Inputs = 1024;
+
+// results are added to this, so that the compiler can not leave out the benchmarked operations
+volatile u64 sink = 0;
+
+struct Result {
+    std::string name;
+    double ns_per_op;
+    double allocations_per_op;
+};
+
+struct Microbenchmark {
+    std::string filter{};
+    double min_time = 0.2;
+    std::vector<Result> results{};
+
+    // run op(i) for i = 0, 1, 2, ... in batches until it ran for min_time seconds
+    template<class F>
+    void Run(const std::string& name, const F& op) {
+        if (name.find(filter) == std::string::npos) {
+            return;
+        }
+
+        // warm up (this also lets the inputs reach their steady state capacities)
+        for (size_t i = 0; i < Inputs; i++) op(i);
+
+        size_t ops = 0, batch = Inputs;
+        u64 allocated = 0;
+        std::chrono::duration<double> elapsed{0};
+        while (elapsed.count() < min_time) {
+            const u64 allocated_before = allocations.load(std::memory_order_relaxed);
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < batch; i++) op(i);
+            elapsed += std::chrono::steady_clock::now() - start;
+            allocated += allocations.load(std::memory_order_relaxed) - allocated_before;
+            ops += batch;
+            batch *= 2;
+        }
+
+        results.push_back({name, 1e9 * elapsed.count() / ops, double(allocated) / ops});
+        std::printf("%-48s %12.2f ns/op %8.3f allocations/op\n", name.c_str(), results.back().ns_per_op,
+                    results.back().allocations_per_op);
+    }
+};
+
+template<size_t N>
+Simplex<N> RandomSimplex(std::mt19937_64& random, int points) {
+    Simplex<N> s{};
+    while (s.Count() < points) {
+        const size_t p = random() % N;
+        s.points[p / s.bits] |= 1ull << (p % s.bits);
+    }
+    return s;
+}
+
+template<size_t N>
+void SimplexBenchmarks(Microbenchmark& bench) {
+    const std::string suffix = "<" + std::to_string(N) + ">";
+    std::mt19937_64 random{N};
+    std::vector<Simplex<N>> a(Inputs), b(Inputs);
+    for (size_t i = 0; i < Inputs; i++) {
+        a[i] = RandomSimplex<N>(random, 2 + random() % 3);
+        // half of the pairs share their lowest point, so that operator< has to look further than the first point
+        b[i] = (i & 1) ? RandomSimplex<N>(random, 2 + random() % 3) : a[i] ^ Simplex<N>(a[i].FindHigh());
+        if (!b[i]) b[i] = a[i];
+    }
+    const auto mask = Inputs - 1;
+
+    bench.Run("Simplex" + suffix + "::operator<", [&](size_t i) {
+        sink = sink + (a[i & mask] < b[i & mask]);
+    });
+    bench.Run("Simplex" + suffix + "::operator^", [&](size_t i) {
+        sink = sink + (a[i & mask] ^ b[i & mask]).points[0];
+    });
+    bench.Run("Simplex" + suffix + "::ForEachPoint", [&](size_t i) {
+        int sum = 0;
+        a[i & mask].ForEachPoint([&](int p) { sum += p; });
+        sink = sink + sum;
+    });
+    bench.Run("Simplex" + suffix + "::FindLow", [&](size_t i) {
+        sink = sink + a[i & mask].FindLow();
+    });
+    bench.Run("Simplex" + suffix + "::FindHigh", [&](size_t i) {
+        sink = sink + a[i & mask].FindHigh();
+    });
+    bench.Run("hash_value(Simplex" + suffix + ")", [&](size_t i) {
+        sink = sink + hash_value(a[i & mask]);
+    });
+}
+
+template<size_t N>
+void ColumnBenchmarks(Microbenchmark& bench, size_t length) {
+    using column_t = Column<N>;
+    const std::string suffix = "<" + std::to_string(N) + ">, " + std::to_string(length) + " entries";
+
+    // fewer inputs for long columns, to keep the memory use down
+    const size_t inputs = std::min<size_t>(Inputs, std::bit_floor(16 * Inputs / length));
+    const auto mask = inputs - 1;
+    std::mt19937_64 random{N + length};
+    std::uniform_real_distribution<float> values{0, 1};
+    std::vector<column_t> a(inputs), b(inputs);
+    for (size_t i = 0; i < inputs; i++) {
+        for (size_t j = 0; j < length; j++) {
+            const typename column_t::entry_t entry{filtration_t(length * values(random)), RandomSimplex<N>(random, 3)};
+            a[i].data.insert(entry);
+            b[i].data.insert((j & 1) ? entry : typename column_t::entry_t{
+                filtration_t(length * values(random)), RandomSimplex<N>(random, 3)
+            });
+        }
+    }
+
+    // adding b twice gives a again, so the columns stay the same length
+    bench.Run("Column" + suffix + "::operator^=", [&](size_t i) {
+        a[i & mask] ^= b[i & mask];
+        sink = sink + a[i & mask].data.size();
+    });
+    // a new column, like the boundaries and reduced columns in a reduction
+    bench.Run("Column" + suffix + " copy + operator^=", [&](size_t i) {
+        column_t c = a[i & mask];
+        c ^= b[i & mask];
+        sink = sink + c.data.size();
+    });
+    bench.Run("Column" + suffix + "::FindLow", [&](size_t i) {
+        sink = sink + a[i & mask].FindLow().points[0];
+    });
+}
+
+template<size_t N>
+void ColumnBenchmarks(Microbenchmark& bench) {
+    for (const size_t length : {3, 32, 512}) {
+        ColumnBenchmarks<N>(bench, length);
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    Microbenchmark bench{};
+    std::string output_file{};
+    for (int i = 1; i < argc; i++) {
+        const std::string arg{argv[i]};
+        try {
+            if (arg.starts_with("--filter=")) {
+                bench.filter = arg.substr(9);
+            }
+            else if (arg.starts_with("--min-time=")) {
+                bench.min_time = std::stod(arg.substr(11));
+            }
+            else if (!arg.starts_with("--") && output_file.empty()) {
+                output_file = arg;
+            }
+            else {
+                std::printf("Unknown option %s\n", arg.c_str());
+                return 1;
+            }
+        }
+        catch (std::logic_error&) {
+            std::printf("Invalid value in %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    SimplexBenchmarks<64>(bench);
+    SimplexBenchmarks<512>(bench);
+    SimplexBenchmarks<2048>(bench);
+    ColumnBenchmarks<64>(bench);
+    ColumnBenchmarks<512>(bench);
+    ColumnBenchmarks<2048>(bench);
+
+    if (!output_file.empty()) {
+        std::ofstream csv(output_file);
+        if (!csv) {
+            std::printf("Could not open %s\n", output_file.c_str());
+            return 1;
+        }
+        csv << "benchmark,ns_per_op,allocations_per_op" << std::endl;
+        for (const auto& [name, ns_per_op, allocations_per_op] : bench.results) {
+            // the names contain commas
+            csv << '"' << name << "\"," << ns_per_op << "," << allocations_per_op << std::endl;
+        }
+    }
+    return 0;
+}
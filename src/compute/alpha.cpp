@@ -0,0 +1,120 @@
+#include "alpha.h"
+
+#include "delaunay.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+
+Filtration Alpha::FindFiltration() const {
+    if (dim > point_t::dim) {
+        throw std::runtime_error("Alpha complex dimension is larger than the dimension of the points");
+    }
+    switch (dim) {
+        case 2: return FindFiltrationImpl<2>();
+        case 3:
+            // points in a plane of constant third coordinate (like those of a file with 2 columns) have no 3 dimensional
+            // triangulation, but their alpha complex is the one of their first 2 coordinates
+            if (std::all_of(points.begin(), points.end(), [&](const point_t& p) { return p[2] == points[0][2]; })) {
+                return FindFiltrationImpl<2>();
+            }
+            return FindFiltrationImpl<3>();
+        default: throw std::runtime_error("Alpha complexes can only be found for 2 or 3 dimensional points");
+    }
+}
+
+template<int D>
+Filtration Alpha::FindFiltrationImpl() const {
+    // vertices of a simplex (sorted, unused vertices are -1)
+    using vertices_t = std::array<i32, D + 1>;
+
+    const Delaunay<D> delaunay{points};
+
+    // simplices[k] are the k-simplices of the triangulation, every simplex keeps its cofaces (by their index
+    // in simplices[k + 1]) together with the vertex opposite of it in that coface
+    std::array<std::vector<vertices_t>, D + 1> simplices{};
+    std::array<std::vector<std::vector<std::pair<size_t, i32>>>, D + 1> cofaces{};
+    simplices[D] = delaunay.FindCells();
+    for (int k = D; k > 1; k--) {
+        boost::unordered_map<vertices_t, size_t> index{};
+        for (size_t s = 0; s < simplices[k].size(); s++) {
+            const vertices_t simplex = simplices[k][s];
+            for (int drop = 0; drop <= k; drop++) {
+                vertices_t face;
+                face.fill(-1);
+                for (int i = 0, j = 0; i <= k; i++) {
+                    if (i != drop) face[j++] = simplex[i];
+                }
+
+                const auto [it, inserted] = index.emplace(face, simplices[k - 1].size());
+                if (inserted) {
+                    simplices[k - 1].push_back(face);
+                    cofaces[k - 1].emplace_back();
+                }
+                cofaces[k - 1][it->second].emplace_back(s, simplex[drop]);
+            }
+        }
+    }
+
+    std::vector<std::array<double, D>> coords(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        for (int c = 0; c < D; c++) {
+            coords[i][c] = points[i][c];
+        }
+    }
+
+    /*
+     * Going down in dimension, a simplex is attached to its cofaces if one of their opposite vertices lies inside
+     * its smallest circumsphere, then it appears with its first coface. Otherwise it appears at the radius of that
+     * sphere (which can never be later than its cofaces, but we make sure that rounding does not break this).
+     * */
+    std::array<std::vector<double>, D + 1> values{};
+    std::vector<const std::array<double, D>*> opposite{};
+    for (int k = D; k >= 1; k--) {
+        values[k].resize(simplices[k].size());
+        for (size_t s = 0; s < simplices[k].size(); s++) {
+            std::array<const std::array<double, D>*, D + 1> p{};
+            for (int i = 0; i <= k; i++) {
+                p[i] = &coords[simplices[k][s][i]];
+            }
+
+            double attached = std::numeric_limits<double>::infinity();
+            opposite.clear();
+            if (k < D) {
+                for (const auto [coface, vertex] : cofaces[k][s]) {
+                    attached = std::min(attached, values[k + 1][coface]);
+                    opposite.push_back(&coords[vertex]);
+                }
+            }
+
+            bool gabriel;
+            const double radius2 = Predicates<D>::SmallestCircumsphere(p, k, opposite, gabriel);
+            values[k][s] = gabriel ? std::min(radius2, attached) : attached;
+        }
+    }
+
+    Filtration result{};
+    for (int k = 1; k <= std::min(D, MAX_HOMOLOGY_DIM); k++) {
+        auto& target = result.simplices[k - 1];
+        target.reserve(simplices[k].size());
+        for (size_t s = 0; s < simplices[k].size(); s++) {
+            Filtration::vertices_t vertices;
+            vertices.fill(-1);
+            std::copy(simplices[k][s].begin(), simplices[k][s].begin() + k + 1, vertices.begin());
+            target.emplace_back(4 * values[k][s], vertices);
+        }
+    }
+
+    // coinciding points are connected right away
+    for (const auto [duplicate, original] : delaunay.duplicates) {
+        Filtration::vertices_t vertices;
+        vertices.fill(-1);
+        vertices[0] = original;
+        vertices[1] = duplicate;
+        result.simplices[0].emplace_back(0, vertices);
+    }
+    return result;
+}
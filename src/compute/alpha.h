@@ -0,0 +1,33 @@
+#pragma once
+
+#include "point.h"
+#include "filtration.h"
+#include "default.h"
+
+#include <span>
+#include <vector>
+
+/*
+ * The alpha complex of a 2D or 3D point cloud (using the first 2 or 3 coordinates of the points) consists of
+ * the simplices of its Delaunay triangulation. A simplex appears at the (squared) radius of its smallest circumsphere
+ * if that sphere contains no other points, and otherwise together with its first coface. It has the same persistent
+ * homology as the Cech complex, but it only has as many simplices as the Delaunay triangulation.
+ * The values are stored as 4 r^2, so that edges appear at their squared length (like in the Vietoris Rips complex).
+ * */
+
+struct Alpha {
+    using point_t = point_max;
+
+    Alpha(std::span<const point_t> points, int dim) : points(points), dim(dim) {
+
+    }
+
+    const std::span<const point_t> points;
+    const int dim;
+
+    Filtration FindFiltration() const;
+
+private:
+    template<int D>
+    Filtration FindFiltrationImpl() const;
+};
@@ -1,22 +1,153 @@
 #pragma once
 
 #include "simplex.h"
+#include "trace.h"
+#include <array>
+#include <bit>
+#include <new>
 #include <boost/container/flat_set.hpp>
+#include <memory_resource>
+#include <type_traits>
+
+
+// filtration value of a simplex, its rank among all edge values if the filtration is quantized
+using filtration_t = std::conditional_t<QUANTIZE_FILTRATION, u32, float>;
+
+/*
+ * Allocator that takes its memory from a memory resource (the arena of a reduction), like
+ * std::pmr::polymorphic_allocator. Unlike that one, it does not construct the elements itself, so containers can
+ * still move trivially copyable elements around with memmove, and copies of a container stay in the same resource.
+ * */
+template<class T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+    ArenaAllocator() = default;
+
+    ArenaAllocator(std::pmr::memory_resource* resource) : resource(resource) {
+
+    }
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : resource(other.resource) {
+
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        resource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return resource == other.resource || resource->is_equal(*other.resource);
+    }
+};
+
+
+/*
+ * Memory resource for the columns of a reduction. Blocks are rounded up to a size class (4 per power of two) and taken
+ * from a monotonic buffer, freed blocks are kept in a list per size class and handed out again. Nothing is returned
+ * to the system before the arena is destroyed, which then releases all of it at once.
+ * */
+struct ColumnArena final : std::pmr::memory_resource {
+    ColumnArena() = default;
+
+    ~ColumnArena() final {
+        trace::Counter("column memory", 0);
+    }
+
+    ColumnArena(const ColumnArena&) = delete;
+    ColumnArena& operator=(const ColumnArena&) = delete;
+
+    // bytes of all blocks that were handed out, including reused ones
+    size_t allocated = 0;
+
+    // bytes of the blocks that are currently in use
+    size_t in_use = 0;
+
+private:
+    static constexpr size_t MinBlock = 16;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    std::pmr::monotonic_buffer_resource buffer{};
+    std::array<FreeBlock*, 4 * 64> free{};
+
+    // in_use when it was last traced, it is traced again whenever it changed by a megabyte
+    size_t traced = 0;
+
+    void TraceInUse() {
+        if (trace::enabled.load(std::memory_order_relaxed)) [[unlikely]] {
+            if (std::max(in_use, traced) - std::min(in_use, traced) >= (1 << 20)) {
+                trace::Counter("column memory", in_use);
+                traced = in_use;
+            }
+        }
+    }
+
+    // size class and size of a block of at least the given size
+    static std::pair<size_t, size_t> SizeClass(size_t bytes) {
+        const size_t size = std::max(bytes, MinBlock);
+        // 2^(octave - 1) < size <= 2^octave, which we split into 4 steps of 2^(octave - 3)
+        const int octave = std::bit_width(size - 1);
+        const int step = octave - 3;
+        const size_t steps = ((size - 1) >> step) + 1;
+        return {4 * octave + steps - 5, steps << step};
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) final {
+        const auto [size_class, size] = SizeClass(bytes);
+        allocated += size;
+        in_use += size;
+        TraceInUse();
+        if (FreeBlock* block = free[size_class]) {
+            free[size_class] = block->next;
+            return block;
+        }
+        return buffer.allocate(size, std::max(alignment, alignof(FreeBlock)));
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t) final {
+        const auto [size_class, size] = SizeClass(bytes);
+        in_use -= size;
+        TraceInUse();
+        free[size_class] = new(p) FreeBlock{free[size_class]};
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept final {
+        return this == &other;
+    }
+};
 
 
 template<size_t N>
 struct Column {
     using simplex_t = Simplex<N>;
-    using vector_t = boost::container::flat_set<std::pair<float, simplex_t>>;
+    using entry_t = std::pair<filtration_t, simplex_t>;
+    using allocator_t = ArenaAllocator<entry_t>;
+    using vector_t = boost::container::flat_set<entry_t, std::less<entry_t>, allocator_t>;
 
     vector_t data;
 
-    Column<N>() = default;
+    Column() = default;
+
+    explicit Column(allocator_t allocator) : data(allocator) {
 
-    explicit Column<N>(float dist, simplex_t s) : data{} {
+    }
+
+    explicit Column(filtration_t dist, simplex_t s, allocator_t allocator = {}) : data(allocator) {
         data.emplace(dist, s);
     }
 
+
     bool Contains(const simplex_t& s) {
         return data.contains(s);
     }
@@ -25,7 +156,7 @@ struct Column {
         return !data.empty();
     }
 
-    Column<N>& operator^=(const Column<N>& other) {
+    Column& operator^=(const Column& other) {
         // in-place, using ordering of the set
         typename vector_t::const_iterator it = data.begin();
         for (const auto s : other.data) {
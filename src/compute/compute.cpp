@@ -1,51 +1,104 @@
 #include "compute.h"
 
 #include "static_for.h"
+#include "parallel.h"
 
 #include <thread>
 #include <future>
 #include <limits>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <cstdio>
 #include <boost/preprocessor/repetition/repeat.hpp>
 
 
 template<size_t N>
-template<size_t n>
-std::vector<i32> Compute<N>::FindSimplexDrawIndicesImpl([[maybe_unused]] float epsilon) {
-    std::vector<i32> indices = {};
-    indices.reserve(n * points.size());
-    this->ComputeBase::current_simplices = 0;
-
-    ForEachSimplex<n>(epsilon, false, [&](float dist, simplex_t s) {
-        this->ComputeBase::current_simplices++;
-        s.ForEachPoint([&](int p) {
-            if constexpr(n < 3) {
-                // we can't draw higher dimensional simplices anyway
-                indices.push_back(p);
+void Compute<N>::FindEdgeValues(std::vector<float> distances) {
+    const size_t size = points.size();
+    if (distances.empty()) {
+        distances.assign(size * size, 0);
+        for (int i = 0; i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                distances[i * size + j] = distances[j * size + i] = Distance2(i, j);
             }
-        });
-    });
-    return std::move(indices);
+        }
+    }
+
+    if constexpr(quantized) {
+        values = {0};
+        values.reserve(size * size / 2 + 1);
+        for (int i = 0; i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                values.push_back(distances[i * size + j]);
+            }
+        }
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+
+        edge_values.assign(size * size, 0);
+        for (int i = 0; i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                edge_values[i * size + j] = edge_values[j * size + i] = Rank(distances[i * size + j]);
+            }
+        }
+    }
+    else {
+        edge_values = std::move(distances);
+    }
 }
 
 template<size_t N>
-boost::container::static_vector<std::vector<i32>, 3> Compute<N>::FindSimplexDrawIndices(float epsilon, int n) {
-    boost::container::static_vector<std::vector<i32>, 3> result{};
+template<size_t n>
+void Compute<N>::FindSimplexDrawBuffersImpl(float epsilon, DrawBuffers& buffers) {
+    // drawing only needs the simplices ordered by their values, so we sort the simplices in the order they were
+    // found by only their values, which is a lot cheaper than the filtration order of ForEachSimplex
+    struct Entry {
+        filtration_t value;
+        u32 found;
+    };
+    std::vector<Entry> entries{};
+    // vertices of the simplices in the order they were found (we can't draw higher dimensional simplices anyway)
+    std::vector<i32> vertices{};
+
+    progress.Start(Progress::Phase::Indices, n);
+    ForEachSimplex<n>(epsilon, false, [&](filtration_t dist, simplex_t s) {
+        entries.push_back({dist, (u32)entries.size()});
+        if constexpr(n < 3) {
+            s.ForEachPoint([&](int p) {
+                vertices.push_back(p);
+            });
+        }
+    });
+    detail::radix_sort(entries, [](const Entry& entry) { return detail::radix_key(entry.value); }, 32);
 
-    result.push_back(FindSimplexDrawIndicesImpl<0>(epsilon));
-    if (n >= 1) {
-        result.push_back(FindSimplexDrawIndicesImpl<1>(epsilon));
+    auto& values = buffers.values.emplace_back();
+    values.reserve(entries.size());
+    for (const auto& [value, _] : entries) {
+        values.push_back(Value(value));
     }
-    if (n >= 2) {
-        result.push_back(FindSimplexDrawIndicesImpl<2>(epsilon));
-    }
-    if (n >= 3) {
-        detail::static_for<size_t, 0, MAX_HOMOLOGY_DIM_P1>([&](auto i) {
-            if (i == n) {
-                // just to see how long it actually takes to compute
-                FindSimplexDrawIndicesImpl<i>(epsilon);
-            }
-        });
+    if constexpr(n < 3) {
+        auto& indices = buffers.indices.emplace_back();
+        indices.reserve(vertices.size());
+        for (const auto& [_, found] : entries) {
+            indices.insert(indices.end(), vertices.begin() + found * (n + 1), vertices.begin() + (found + 1) * (n + 1));
+        }
     }
+}
+
+template<size_t N>
+typename ComputeBase::DrawBuffers Compute<N>::FindSimplexDrawBuffers(float epsilon, int n) {
+    n = std::clamp(n, 0, MAX_HOMOLOGY_DIM);
+    Admit(epsilon, n);
+
+    DrawBuffers result{};
+    // the points are there at any epsilon
+    result.max_epsilon = n == 0 ? std::numeric_limits<float>::infinity() : epsilon;
+    detail::static_for<size_t, 0, MAX_HOMOLOGY_DIM_P1>([&](auto i) {
+        if (i <= n) {
+            FindSimplexDrawBuffersImpl<i>(epsilon, result);
+        }
+    });
     return result;
 }
 
@@ -57,26 +110,31 @@ std::pair<typename Compute<N>::basis_t, typename Compute<N>::basis_t> Compute<N>
     // store low -> simplex
     using b_matrix_t = boost::container::static_vector<std::optional<std::pair<simplex_t, simplex_t>>, N>;
     // higher dimensional simplex -> 1-simplex column (starts as diagonal)
-    using z_matrix_t = boost::unordered_map<simplex_t, column_t>;
+    using z_matrix_t = arena_map_t<simplex_t, column_t>;
 
     // store low -> simplex
     b_matrix_t B(points.size());
     // simplex -> column
-    z_matrix_t Z{};
+    z_matrix_t Z{arena};
     // basis results (can be constructed while finding them)
-    basis_t b_basis{};
-    basis_t z_basis{};
-
-    ForEachSimplex<1>(epsilon, ordered, [&](float dist, const simplex_t s) {
+    basis_t b_basis{arena};
+    basis_t z_basis{arena};
+
+    progress.Start(Progress::Phase::Reduction, 1);
+    ForEachSimplex<1>(epsilon, ordered, [&](filtration_t dist, const simplex_t s) {
+        if (!morse.empty() && Probe(morse[0]).count(s)) {
+            // paired with a 2-simplex by the Morse matching, so it is not critical
+            return;
+        }
         auto b_col = s;
-        auto z_col = column_t{dist, s};
+        auto z_col = column_t{dist, s, arena};
         int low = b_col.FindLow();
         while (B[low].has_value()) {
             const auto& [low_s, low_col] = B[low].value();
             b_col ^= low_col;
 
             // low has been found before, so we know that low_s is in Z
-            z_col ^= Z.at(low_s);
+            AddColumn(z_col, Probe(Z).at(low_s));
             if (!b_col) break;
             low = b_col.FindLow();
         }
@@ -87,29 +145,30 @@ std::pair<typename Compute<N>::basis_t, typename Compute<N>::basis_t> Compute<N>
             b_basis.emplace_back(s, BoundaryOf<1>(s));
 
             // this column has not been added to Z yet (low never found)
-            Z.emplace(s, z_col);
+            Probe(Z).emplace(s, std::move(z_col));
         }
         else {
             // column will never be read from again in Z, since it ends up being zero
             // it is part of the z_basis though
-            z_basis.emplace_back(s, z_col);
+            z_basis.emplace_back(s, std::move(z_col));
         }
     });
 
-    // reduce B basis (unique low)
-    z_matrix_t reduced{};
-    for (auto& [_, c] : b_basis) {
+    // reduce B basis (unique low), low -> index of the reduced column in b_basis
+    arena_map_t<simplex_t, u32> reduced{arena};
+    for (u32 i = 0; i < b_basis.size(); i++) {
+        auto& c = b_basis[i].second;
         auto low = c.FindLow();
-        while (reduced.find(low) != reduced.end()) {
-            c ^= reduced.at(low);
+        for (auto it = Probe(reduced).find(low); it != reduced.end(); it = Probe(reduced).find(low)) {
+            AddColumn(c, b_basis[it->second].second);
             low = c.FindLow();
         }
-        reduced.emplace(low, c);
+        Probe(reduced).emplace(low, i);
     }
 
     // basis for B{n} is all non-zero columns
     // basis for Z{n + 1} is all zero-columns, which we have already kept track of
-    return std::make_pair(b_basis, z_basis);
+    return std::make_pair(std::move(b_basis), std::move(z_basis));
 }
 
 
@@ -117,139 +176,577 @@ template<size_t N>
 template<int n>
 std::pair<typename Compute<N>::basis_t, typename Compute<N>::basis_t> Compute<N>::FindBZn(float epsilon, bool ordered) {
     if constexpr(n == -1) {
-        basis_t z_basis{};
+        basis_t z_basis{arena};
         for (int i = 0; i < points.size(); i++) {
-            z_basis.emplace_back(simplex_t{i}, column_t{0, simplex_t{i}});
+            z_basis.emplace_back(simplex_t{i}, column_t{0, simplex_t{i}, arena});
         }
-        return std::make_pair(basis_t{}, z_basis);
+        return std::make_pair(basis_t{arena}, std::move(z_basis));
     }
     else if constexpr(n == 0) {
         return FindBZ0(epsilon, ordered);
     }
     else {
-        // low -> column
-        using b_matrix_t = boost::unordered_map<simplex_t, std::pair<simplex_t, column_t>>;
+        // low -> index of the (reduced) column in b_basis, which holds the only copy of it
+        using b_matrix_t = arena_map_t<simplex_t, u32>;
         // higher dimensional simplex -> column (starts at diagonal)
-        using z_matrix_t = boost::unordered_map<simplex_t, column_t>;
+        using z_matrix_t = arena_map_t<simplex_t, column_t>;
 
         // store low -> simplex
-        b_matrix_t B{};
+        b_matrix_t B{arena};
         // simplex -> column
-        z_matrix_t Z{};
+        z_matrix_t Z{arena};
         // basis results (can be constructed while finding them)
-        basis_t b_basis{};
-        basis_t z_basis{};
-
-        ForEachSimplex<n + 1>(epsilon, ordered, [&](float dist, simplex_t s) {
-            auto b_col = BoundaryOf<n + 1>(s);
-            auto z_col = column_t{dist, s};
-            simplex_t low = b_col.FindLow();
-            while (B.find(low) != B.end()) {
-                const auto& [low_s, low_col] = B.at(low);
-                b_col ^= low_col;
+        basis_t b_basis{arena};
+        basis_t z_basis{arena};
+
+        progress.Start(Progress::Phase::Reduction, n + 1);
+        ForEachSimplex<n + 1>(epsilon, ordered, [&](filtration_t dist, simplex_t s) {
+            if (!morse.empty() && Probe(morse[n]).count(s)) {
+                // paired by the Morse matching, so it is not critical
+                return;
+            }
+            auto b_col = morse.empty() ? BoundaryOf<n + 1>(s) : MorseBoundaryOf<n + 1>(s);
+            auto z_col = column_t{dist, s, arena};
+            // the Morse boundary of a simplex may be empty, it is then a cycle right away
+            simplex_t low = b_col ? b_col.FindLow() : simplex_t{};
+            for (auto it = Probe(B).find(low); it != B.end(); it = Probe(B).find(low)) {
+                const auto& [low_s, low_col] = b_basis[it->second];
+                AddColumn(b_col, low_col);
 
                 // low has been found before, so we know that low_s is in Z
-                z_col ^= Z.at(low_s);
+                AddColumn(z_col, Probe(Z).at(low_s));
                 if (!b_col) break;
                 low = b_col.FindLow();
             }
             if (b_col) {
-                B.emplace(low, std::make_pair(s, b_col));
+                Probe(B).emplace(low, b_basis.size());
 
                 // this column will never be added to again and is non-zero
-                b_basis.emplace_back(s, b_col);
+                b_basis.emplace_back(s, std::move(b_col));
 
                 // this column has not been added to Z yet (low never found)
-                Z.emplace(s, z_col);
+                Probe(Z).emplace(s, std::move(z_col));
             }
             else {
                 // column will never be read from again in Z, since it ends up being zero
                 // it is part of the z_basis though
-                z_basis.emplace_back(s, z_col);
+                z_basis.emplace_back(s, std::move(z_col));
             }
         });
 
         // basis for B{n} is all non-zero columns
         // basis for Z{n + 1} is all zero-columns, which we have already kept track of
-        return std::make_pair(b_basis, z_basis);
+        return std::make_pair(std::move(b_basis), std::move(z_basis));
     }
 }
 
 template<size_t N>
-typename Compute<N>::basis_t Compute<N>::FindHBasis(const basis_t& B, const basis_t& Z) const {
-    // reduce Z basis to a basis of H
-    // basically just sweep the lowest elements
-    boost::unordered_map<simplex_t, column_t> reduced{};
-    for (auto [_, c] : Z) {
-        auto low = c.FindLow();
-        while (reduced.find(low) != reduced.end()) {
-            c ^= reduced.at(low);
-            low = c.FindLow();
+void Compute<N>::CollapseEdges(float epsilon) {
+    /*
+     * An edge (a, b) is dominated by a vertex v if the closed neighborhood of the edge (the common neighbors
+     * of a and b, and a and b themselves) is contained in the closed neighborhood of v. Removing a dominated
+     * edge is a strong collapse of the flag complex, so it does not change its homotopy type.
+     * For a filtration, we sweep the edges backwards (Boissonnat-Pritam style). An edge that is dominated when it
+     * is inserted can be inserted later, namely as soon as it stops being dominated when the later edges are
+     * inserted at their (already shifted) times. If that never happens, the edge is removed altogether.
+     * The inclusions of the collapsed graph into the original one then induce isomorphisms on homology for every
+     * epsilon, so the barcode does not change.
+     * */
+    FindnSimplices<1>(epsilon);
+    const size_t size = points.size();
+    progress.Start(Progress::Phase::Collapse, 1);
+
+    // edges in filtration order
+    std::vector<std::pair<filtration_t, simplex_t>> edges{};
+    edges.reserve(cache[0].Load().size());
+    ForEachSimplex<1>(epsilon, true, [&](filtration_t dist, simplex_t s) {
+        edges.emplace_back(dist, s);
+    });
+
+    std::vector<std::pair<i32, i32>> endpoints{};
+    endpoints.reserve(edges.size());
+    for (const auto& [_, s] : edges) {
+        endpoints.emplace_back(s.FindLow(), s.FindHigh());
+    }
+
+    // time[a * size + b] is the index at which the edge (a, b) is inserted
+    // every vertex is in its own (closed) neighborhood from the start
+    constexpr u32 never = std::numeric_limits<u32>::max();
+    std::vector<u32> time(size * size, never);
+    for (size_t v = 0; v < size; v++) {
+        time[v * size + v] = 0;
+    }
+    for (u32 k = 0; k < endpoints.size(); k++) {
+        const auto [a, b] = endpoints[k];
+        time[a * size + b] = time[b * size + a] = k;
+    }
+
+    // whether an edge is dominated at the time it is inserted only depends on the original filtration
+    // so we find a dominating vertex (if any) for all edges in parallel, using bitsets for the neighborhoods
+    std::vector<i32> dominator(edges.size(), -1);
+    detail::parallel_for(0, edges.size(), [&](size_t begin, size_t end, size_t) {
+        std::vector<simplex_t> neighborhood(size);
+        for (int v = 0; v < size; v++) {
+            neighborhood[v] = simplex_t{v};
+        }
+        auto insert = [&](size_t k) {
+            const auto [a, b] = endpoints[k];
+            neighborhood[a] |= simplex_t{b};
+            neighborhood[b] |= simplex_t{a};
+        };
+        for (size_t k = 0; k < begin; k++) {
+            insert(k);
         }
 
-#ifndef NDEBUG
-        if (!c) [[unlikely]] {
-            throw std::runtime_error("Bad basis for Z");
+        for (size_t k = begin; k < end; k++) {
+            insert(k);
+            const auto [a, b] = endpoints[k];
+            const simplex_t common = neighborhood[a] & neighborhood[b];
+            common.ForEachPoint([&](int v) -> bool {
+                if (v != a && v != b && (common & neighborhood[v]) == common) {
+                    dominator[k] = v;
+                    return true;
+                }
+                return false;
+            });
+        }
+    }, 1024);
+
+    // find a vertex dominating the edge (a, b) when all edges with time at most j are inserted
+    std::vector<i32> common{};
+    auto find_dominator = [&](i32 a, i32 b, u32 j) -> i32 {
+        common.clear();
+        for (int u = 0; u < size; u++) {
+            if (time[a * size + u] <= j && time[b * size + u] <= j) {
+                common.push_back(u);
+            }
+        }
+        for (const auto v : common) {
+            if (v == a || v == b) continue;
+            if (std::all_of(common.begin(), common.end(), [&](i32 u) { return time[v * size + u] <= j; })) {
+                return v;
+            }
+        }
+        return -1;
+    };
+
+    // sweep backwards, all edges after the current one have their final (shifted) time
+    // inserted[v] holds the shifted times of these edges at v
+    std::vector<std::vector<std::pair<u32, i32>>> inserted(size);
+    std::vector<std::pair<u32, i32>> events{};
+    progress.Start(Progress::Phase::Collapse, 1, edges.size());
+    for (u32 k = edges.size(); k-- > 0;) {
+        Step(edges.size() - k);
+        const auto [a, b] = endpoints[k];
+        u32 shifted = k;
+
+        if (dominator[k] >= 0) {
+            // the domination can only break when an edge at a or b is inserted, so we only check those times
+            i32 v = dominator[k];
+            shifted = never;
+            events.clear();
+            events.insert(events.end(), inserted[a].begin(), inserted[a].end());
+            events.insert(events.end(), inserted[b].begin(), inserted[b].end());
+            std::sort(events.begin(), events.end());
+
+            for (const auto [j, x] : events) {
+                if (time[a * size + x] > j || time[b * size + x] > j) {
+                    // x did not become a common neighbor
+                    continue;
+                }
+                if (time[v * size + x] <= j) {
+                    // still dominated by v
+                    continue;
+                }
+                v = find_dominator(a, b, j);
+                if (v < 0) {
+                    shifted = j;
+                    break;
+                }
+            }
         }
-#endif
-        reduced.emplace(low, c);
-    }
 
-    for (const auto& [_, c] : B) {
-        auto low = c.FindLow();
-        reduced.erase(low);
+        time[a * size + b] = time[b * size + a] = shifted;
+        if (shifted != never) {
+            inserted[a].emplace_back(shifted, b);
+            inserted[b].emplace_back(shifted, a);
+        }
     }
 
-    basis_t result{};
-    for (auto [s, c] : reduced) {
-        result.emplace_back(s, c);
+    // replace the edges by the collapsed ones, the higher dimensional simplices are then found using their new values
+    // the collapsed filtration is only valid up to epsilon, so we never look for new edges after this (until
+    // FindBarcode restores the original edges)
+    // edges that are removed get a value that is larger than any bound
+    constexpr filtration_t removed = quantized ?
+            std::numeric_limits<filtration_t>::max() : std::numeric_limits<filtration_t>::infinity();
+    edge_values.assign(size * size, removed);
+    for (size_t v = 0; v < size; v++) {
+        edge_values[v * size + v] = 0;
+    }
+    auto collapsed = std::make_unique<typename cache_t::Snapshot>();
+    for (u32 k = 0; k < edges.size(); k++) {
+        const auto [a, b] = endpoints[k];
+        const u32 shifted = time[a * size + b];
+        if (shifted != never) {
+            const filtration_t dist = edges[shifted].first;
+            edge_values[a * size + b] = edge_values[b * size + a] = dist;
+            collapsed->Add(edges[k].second, dist);
+        }
+    }
+    std::lock_guard lock{searching};
+    cache[0].Reset(std::move(collapsed), std::numeric_limits<float>::infinity());
+    for (int n = 2; n <= MAX_HOMOLOGY_DIM; n++) {
+        cache[n - 1].Clear();
     }
-    return std::move(result);
+    TraceCacheSize(1);
 }
 
 template<size_t N>
-std::pair<size_t, std::vector<i32>> Compute<N>::FindHBasisDrawIndices(float epsilon, int n) {
-    basis_t h_basis;
-    detail::static_for<int, 0, MAX_HOMOLOGY_DIM>([&](auto i) {
-        if (i == n) {
-            auto [b_basis, z_] = FindBZn<i>(epsilon, false);
-            auto [b_, z_basis] = FindBZn<i - 1>(epsilon, false);
-            h_basis = FindHBasis(b_basis, z_basis);
+void Compute<N>::FindMorseMatching(float epsilon) {
+    /*
+     * Apparent pairs: a k-simplex s and a (k + 1)-simplex t are paired if s is the youngest facet of t and t is
+     * the oldest cofacet of s (in the order of ForEachSimplex). These pairs form an acyclic matching that is
+     * compatible with the filtration, and every one of them is a persistence pair. So the reduction only needs the
+     * unpaired (critical) simplices, with their boundaries in the Morse complex (see MorseBoundaryOf).
+     * Vertices are never paired, since FindBZ0 reduces the edges with their plain boundaries.
+     * */
+    morse.assign(MAX_HOMOLOGY_DIM, {});
+    constexpr int max_n = std::min(MAX_HOMOLOGY_DIM, MAX_BARCODE_HOMOLOGY + 1);
+    detail::static_for<int, 2, max_n + 1>([&](auto n) {
+        progress.Start(Progress::Phase::Morse, n);
+        if (flag_complex) {
+            /*
+             * Like in Ripser, the cofacets of s in a flag complex are s and one more vertex, with the value of s or
+             * of the largest new edge. So t is the oldest cofacet of s if no other vertex gives an older one, which
+             * we can check from the edge values (mostly the first one, as most vertices are too far away).
+             * */
+            ForEachSimplex<n>(epsilon, false, [&](filtration_t dist, simplex_t t) {
+                std::pair<filtration_t, simplex_t> young{std::numeric_limits<filtration_t>::lowest(), simplex_t{}};
+                t.ForEachPoint([&](int p) {
+                    const auto s = t ^ simplex_t{p};
+                    young = std::max(young, std::make_pair(ValueOf<n - 1>(s), s));
+                });
+                const auto& [value, s] = young;
+
+                std::array<int, n> vertices;
+                int count = 0;
+                s.ForEachPoint([&](int p) {
+                    vertices[count++] = p;
+                });
+                for (int v = 0; v < points.size(); v++) {
+                    if (t[v]) continue;
+                    filtration_t cofacet_dist = value;
+                    bool older = true;
+                    for (const int p : vertices) {
+                        cofacet_dist = std::max(cofacet_dist, EdgeValue(p, v));
+                        if (cofacet_dist > dist) {
+                            older = false;
+                            break;
+                        }
+                    }
+                    if (older && (cofacet_dist < dist || (s | simplex_t{v}) < t)) {
+                        return;
+                    }
+                }
+                Probe(morse[n - 2]).emplace(s, t);
+                Probe(morse[n - 1]).emplace(t, s);
+            });
+            return;
+        }
+
+        // the cofacets of a given filtration are not known, so we find the oldest cofacet of every (n - 1)-simplex
+        // and the youngest facet of every n-simplex, in an arena of their own that is released per dimension
+        ReductionArena scratch{*this};
+        arena_map_t<simplex_t, std::pair<filtration_t, simplex_t>> oldest{arena};
+        std::vector<std::pair<simplex_t, simplex_t>> youngest{};
+        ForEachSimplex<n>(epsilon, false, [&](filtration_t dist, simplex_t t) {
+            std::pair<filtration_t, simplex_t> young{std::numeric_limits<filtration_t>::lowest(), simplex_t{}};
+            t.ForEachPoint([&](int p) {
+                const auto s = t ^ simplex_t{p};
+                young = std::max(young, std::make_pair(ValueOf<n - 1>(s), s));
+                const auto [it, inserted] = Probe(oldest).try_emplace(s, dist, t);
+                if (!inserted) {
+                    it->second = std::min(it->second, std::make_pair(dist, t));
+                }
+            });
+            youngest.emplace_back(t, young.second);
+        });
+
+        for (const auto& [t, s] : youngest) {
+            if (Probe(oldest).at(s).second == t) {
+                Probe(morse[n - 2]).emplace(s, t);
+                Probe(morse[n - 1]).emplace(t, s);
+            }
         }
     });
+}
 
-    std::vector<i32> result{};
-    for (const auto& [_, c] : h_basis) {
-        for (const auto& [d, s] : c.data) {
-            s.ForEachPoint([&result](int p) {
-                result.push_back(p);
+template<size_t N>
+typename ComputeBase::SizeEstimate Compute<N>::EstimateSize(float epsilon, int n) {
+    n = std::clamp(n, 0, MAX_HOMOLOGY_DIM);
+    const size_t size = points.size();
+
+    SizeEstimate result{};
+    result.simplices[0] = size;
+    if (size == 0 || n == 0) {
+        return result;
+    }
+
+    const filtration_t bound = Bound(epsilon);
+    if (!flag_complex) {
+        // all simplices of a given filtration are in the cache already, so we count them instead
+        for (int k = 1; k <= n; k++) {
+            cache[k - 1].Load().ForEach([&](const simplex_t&, filtration_t diameter) {
+                result.simplices[k] += diameter <= bound;
             });
         }
+        EstimateMemory(result, n);
+        return result;
+    }
+
+    // neighbors of every vertex, and only those with a higher index (so that we count every clique once)
+    std::vector<simplex_t> neighbors(size, simplex_t{}), later(size, simplex_t{});
+    for (int i = 0; i < size; i++) {
+        for (int j = i + 1; j < size; j++) {
+            if (EdgeValue(i, j) <= bound) {
+                neighbors[i] |= simplex_t{j};
+                neighbors[j] |= simplex_t{i};
+                later[i] |= simplex_t{j};
+            }
+        }
     }
-    return std::make_pair(h_basis.size(), std::move(result));
+
+    return EstimateCliques(neighbors, later, n);
 }
 
 template<size_t N>
-std::vector<std::pair<typename Compute<N>::simplex_t, typename Compute<N>::simplex_t>>
-Compute<N>::FindBZBasisPairs(const basis_t& B, const basis_t& Z) const {
+typename ComputeBase::SizeEstimate Compute<N>::EstimateSize(const Graph& graph, float epsilon, int n) {
+    n = std::clamp(n, 0, MAX_HOMOLOGY_DIM);
+    const size_t size = graph.vertices;
+
+    SizeEstimate result{};
+    result.simplices[0] = size;
+    if (size == 0 || n == 0) {
+        return result;
+    }
+
+    // the edges that Graph::FindFiltration keeps at epsilon
+    const float max_value = 4 * epsilon * epsilon;
+    std::vector<simplex_t> neighbors(size, simplex_t{}), later(size, simplex_t{});
+    for (const auto [a, b, distance] : graph.edges) {
+        if (a == b || !(distance * distance <= max_value)) continue;
+        neighbors[a] |= simplex_t{b};
+        neighbors[b] |= simplex_t{a};
+        later[std::min(a, b)] |= simplex_t{std::max(a, b)};
+    }
+    return EstimateCliques(neighbors, later, n);
+}
+
+template<size_t N>
+typename ComputeBase::SizeEstimate
+Compute<N>::EstimateCliques(const std::vector<simplex_t>& neighbors, const std::vector<simplex_t>& later, int n) {
+    /*
+     * The k-simplices are the (k + 1)-cliques of the neighbor graph, so every one of them contains k + 1 vertices.
+     * Counting the cliques that contain a vertex v only takes intersections of (bitset) neighborhoods within N(v),
+     * so we do this for a random sample of the vertices and scale the total by |V| / (sample size * (k + 1)).
+     * */
+    constexpr size_t max_samples = 128;
+    const size_t size = neighbors.size();
+
+    SizeEstimate result{};
+    result.simplices[0] = size;
+
+    // a fixed seed, so that the estimate is monotone in epsilon
+    std::vector<i32> sample(size);
+    std::iota(sample.begin(), sample.end(), 0);
+    if (size > max_samples) {
+        std::vector<i32> all = std::move(sample);
+        sample.clear();
+        std::sample(all.begin(), all.end(), std::back_inserter(sample), max_samples, std::mt19937{0});
+    }
+
+    // counts[k] is the amount of k-simplices containing a sampled vertex
+    // for the last dimension we only need the size of the candidate set
+    std::array<double, MAX_HOMOLOGY_DIM + 1> counts{};
+    auto count = [&](auto& self, const simplex_t& candidates, int k) -> void {
+        if (k == n) {
+            counts[k] += candidates.Count();
+            return;
+        }
+        candidates.ForEachPoint([&](int u) {
+            counts[k]++;
+            self(self, candidates & later[u], k + 1);
+        });
+    };
+    for (const auto v : sample) {
+        count(count, neighbors[v], 1);
+    }
+
+    for (int k = 1; k <= n; k++) {
+        result.simplices[k] = counts[k] * size / (sample.size() * (k + 1));
+    }
+    EstimateMemory(result, n);
+    return result;
+}
+
+template<size_t N>
+void Compute<N>::EstimateMemory(SizeEstimate& estimate, int n) {
+    /*
+     * All k-simplices are kept in the cache. The reduction of the k-simplices then also holds them in order,
+     * with their boundary and a column for Z, and an entry in the B and Z maps. This does not include fill-in,
+     * so the actual peak is higher for large reductions.
+     * */
+    const double cache_entry = sizeof(simplex_t) + sizeof(filtration_t) + 2 * sizeof(u32);
+    const double column_entry = sizeof(std::pair<filtration_t, simplex_t>);
+    const double map_entry = sizeof(simplex_t) + sizeof(column_t) + 2 * sizeof(void*);
+    double cache_memory = 0;
+    double reduction_memory = 0;
+    for (int k = 1; k <= n; k++) {
+        cache_memory += estimate.simplices[k] * cache_entry;
+        reduction_memory = std::max(reduction_memory, estimate.simplices[k] * ((k + 3) * column_entry + 2 * map_entry));
+    }
+    estimate.memory = cache_memory + reduction_memory;
+}
+
+template<size_t N>
+void Compute<N>::Admit(float epsilon, int n) {
+    n = std::min(n, MAX_HOMOLOGY_DIM);
+    if (memory_budget == 0 || !flag_complex || n <= 0) {
+        return;
+    }
+    if (cache[n - 1].Load().max_epsilon >= epsilon) {
+        // already found
+        return;
+    }
+
+    Admit(epsilon, n, memory_budget, [this](float epsilon, int n) { return EstimateSize(epsilon, n); });
+}
+
+template<size_t N>
+void Compute<N>::Admit(const Graph& graph, float epsilon, int n, size_t memory_budget) {
+    n = std::min(n, MAX_HOMOLOGY_DIM);
+    if (memory_budget == 0 || n <= 0) {
+        return;
+    }
+    Admit(epsilon, n, memory_budget, [&graph](float epsilon, int n) { return EstimateSize(graph, epsilon, n); });
+}
+
+template<size_t N>
+template<class E>
+void Compute<N>::Admit(float epsilon, int n, size_t memory_budget, const E& estimate_size) {
+    const auto estimate = estimate_size(epsilon, n);
+    if (estimate.memory <= memory_budget) {
+        return;
+    }
+
+    // the estimate is monotone in both the dimension and epsilon
+    int dim = n - 1;
+    while (dim > 0 && estimate_size(epsilon, dim).memory > memory_budget) {
+        dim--;
+    }
+    float low = 0, high = epsilon;
+    for (int i = 0; i < 16; i++) {
+        const float mid = (low + high) / 2;
+        if (estimate_size(mid, n).memory <= memory_budget) low = mid;
+        else high = mid;
+    }
+
+    char message[512];
+    std::snprintf(
+            message, sizeof(message),
+            "Expected %.3g %d-simplices using %.1f MB at epsilon %.4f, which exceeds the memory budget of %.0f MB. "
+            "Try epsilon %.4f or dimension %d instead.",
+            estimate.simplices[n], n, estimate.memory / (1 << 20), epsilon, (double)memory_budget / (1 << 20), low, dim
+    );
+    throw BudgetExceeded(message, low, dim);
+}
+
+template<size_t N>
+typename Compute<N>::reduced_t Compute<N>::ReduceZBasis(basis_t Z) {
     // reduce Z basis to a basis of H
     // basically just sweep the lowest elements
-    boost::unordered_map<simplex_t, std::pair<simplex_t, column_t>> reduced{};
-    for (auto [s, c] : Z) {
+    reduced_t reduced{arena};
+    progress.Start(Progress::Phase::Reduction, Z.empty() ? 0 : Z[0].first.Count() - 1, Z.size());
+    for (size_t i = 0; i < Z.size(); i++) {
+        Step(i);
+        auto& [s, c] = Z[i];
         auto low = c.FindLow();
-        while (reduced.find(low) != reduced.end()) {
-            c ^= reduced.at(low).second;
+        for (auto it = Probe(reduced).find(low); it != reduced.end(); it = Probe(reduced).find(low)) {
+            AddColumn(c, it->second.second);
             low = c.FindLow();
         }
 
-        reduced.emplace(low, std::make_pair(s, c));
+        Probe(reduced).emplace(low, std::make_pair(s, std::move(c)));
+    }
+    return reduced;
+}
+
+template<size_t N>
+std::vector<std::tuple<typename Compute<N>::simplex_t, typename Compute<N>::simplex_t, typename Compute<N>::column_t>>
+Compute<N>::FindBZBasisCycles(const basis_t& B, basis_t Z) {
+    // the cycle with a low dies with the B column with the same low
+    auto reduced = ReduceZBasis(std::move(Z));
+
+    std::vector<std::tuple<simplex_t, simplex_t, column_t>> result{};
+    // the columns of B are labeled by the (n + 1)-simplices whose boundaries they are
+    progress.Start(Progress::Phase::Reduction, B.empty() ? 0 : B[0].first.Count() - 2, B.size());
+    for (size_t i = 0; i < B.size(); i++) {
+        Step(i);
+        const auto& [s, c] = B[i];
+        const auto it = Probe(reduced).find(c.FindLow());
+        result.emplace_back(s, it->second.first, std::move(it->second.second));
+        // erasing by iterator does not look up the key again
+        reduced.erase(it);
     }
 
+    for (auto& [_, z] : reduced) {
+        // non-paired columns
+        result.emplace_back(simplex_t{}, z.first, std::move(z.second));
+    }
+    return result;
+}
+
+template<size_t N>
+typename ComputeBase::HomologyBars Compute<N>::FindHomologyBars(float max_epsilon, int n) {
+    n = std::clamp(n, 0, MAX_HOMOLOGY_DIM - 1);
+    Admit(max_epsilon, n + 1);
+    ReductionArena reduction{*this};
+
+    HomologyBars result{};
+    result.max_epsilon = max_epsilon;
+    detail::static_for<int, 0, MAX_HOMOLOGY_DIM>([&](auto i) {
+        if (i == n) {
+            auto [b_basis, z_] = FindBZn<i>(max_epsilon, true);
+            auto [b_, z_basis] = FindBZn<i - 1>(max_epsilon, true);
+            for (const auto& [b, z, cycle] : FindBZBasisCycles(b_basis, std::move(z_basis))) {
+                const float death = b ? Value(ValueOf<i + 1>(b)) : std::numeric_limits<float>::infinity();
+                result.bars.emplace_back(Value(ValueOf<i>(z)), death);
+                for (const auto& [d, s] : cycle.data) {
+                    s.ForEachPoint([&result](int p) {
+                        result.indices.push_back(p);
+                    });
+                }
+                result.offsets.push_back(result.indices.size());
+            }
+        }
+    });
+    return result;
+}
+
+template<size_t N>
+std::vector<std::pair<typename Compute<N>::simplex_t, typename Compute<N>::simplex_t>>
+Compute<N>::FindBZBasisPairs(const basis_t& B, basis_t Z) {
+    auto reduced = ReduceZBasis(std::move(Z));
+
     std::vector<std::pair<simplex_t, simplex_t>> result{};
-    for (const auto& [s, c] : B) {
+    // the columns of B are labeled by the (n + 1)-simplices whose boundaries they are
+    progress.Start(Progress::Phase::Reduction, B.empty() ? 0 : B[0].first.Count() - 2, B.size());
+    for (size_t i = 0; i < B.size(); i++) {
+        Step(i);
+        const auto& [s, c] = B[i];
         auto low = c.FindLow();
-        result.emplace_back(s, reduced.at(low).first);
-        reduced.erase(low);
+        result.emplace_back(s, Probe(reduced).at(low).first);
+        Probe(reduced).erase(low);
     }
 
     for (const auto& [s, _] : reduced) {
@@ -263,18 +760,76 @@ template<size_t N>
 std::array<std::vector<std::pair<float, float>>, MAX_BARCODE_HOMOLOGY + 1>
 Compute<N>::FindBarcode(float upper_bound) {
     std::array<std::vector<std::pair<float, float>>, MAX_BARCODE_HOMOLOGY + 1> result{};
+    stats.Clear();
+    // the collapsed edges only belong to this barcode, so the original ones are restored when we are done (or
+    // cancelled), and the simplices that were found from the collapsed ones are dropped
+    struct RestoreEdges {
+        Compute& compute;
+        std::vector<filtration_t> edge_values;
+
+        ~RestoreEdges() {
+            std::lock_guard lock{compute.searching};
+            compute.edge_values = std::move(edge_values);
+            for (auto& simplices : compute.cache) {
+                simplices.Clear();
+            }
+        }
+    };
+    std::optional<RestoreEdges> restore_edges{};
+    // the collapse only needs the edges, and makes the higher dimensional simplices we then expect a lot fewer
+    if (collapse_edges && flag_complex) {
+        Admit(upper_bound, 1);
+        restore_edges.emplace(*this, edge_values);
+        StageTimer timer{stats, "collapse"};
+        CollapseEdges(upper_bound);
+    }
+    constexpr int max_n = std::min(MAX_HOMOLOGY_DIM, MAX_BARCODE_HOMOLOGY + 1);
+    Admit(upper_bound, max_n);
+    FindnSimplices<max_n>(upper_bound);
+    stats.simplices[0] = points.size();
+    for (int n = 1; n <= max_n; n++) {
+        stats.simplices[n] = cache[n - 1].Load().size();
+    }
+    // the matching only belongs to this barcode, so it is cleared when we are done (or cancelled)
+    struct ClearMorse {
+        decltype(morse)& matching;
+
+        ~ClearMorse() {
+            matching.clear();
+        }
+    } clear_morse{morse};
+    {
+        StageTimer timer{stats, "morse"};
+        FindMorseMatching(upper_bound);
+    }
+    ReductionArena reduction{*this};
+
+    // the pairs of the matching are persistence pairs
+    detail::static_for<int, 1, MAX_BARCODE_HOMOLOGY + 1>([&](auto k) {
+        if (k < morse.size()) {
+            for (const auto& [s, t] : morse[k - 1]) {
+                if (t.Count() == k + 2) {
+                    result[k].emplace_back(Value(ValueOf<k>(s)), Value(ValueOf<k + 1>(t)));
+                }
+            }
+        }
+    });
     basis_t z_basis = FindBZn<-1>(upper_bound, true).second;
 
     detail::static_for<int, 0, MAX_HOMOLOGY_DIM>([&](auto i) {
         if (i <= MAX_BARCODE_HOMOLOGY) {
             // compute the basis for B and use the previous basis for Z to compute the next basis for H
+            std::optional<StageTimer> timer{std::in_place, stats, "reduction " + std::to_string(i)};
             auto [b_basis, z_] = FindBZn<i>(upper_bound, true);
-            const auto pairs = FindBZBasisPairs(b_basis, z_basis);
+            timer.emplace(stats, "pairs " + std::to_string(i));
+            const auto pairs = FindBZBasisPairs(b_basis, std::move(z_basis));
+            timer.reset();
             for (const auto& [b, z] : pairs) {
-                float z_dist = i == 0 ? 0 : cache[i - 1].unordered.at(z);
+                // filtration values are only mapped back from their ranks here
+                float z_dist = Value(ValueOf<i>(z));
                 if (b) [[likely]] {
                     // NOT a basis vector for H
-                    result[i].emplace_back(z_dist, cache[i].unordered.at(b));
+                    result[i].emplace_back(z_dist, Value(ValueOf<i + 1>(b)));
                 }
                 else {
                     // basis vector for H
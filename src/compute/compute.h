@@ -3,28 +3,186 @@
 #include "point.h"
 #include "simplex.h"
 #include "column.h"
+#include "simplex_cache.h"
+#include "filtration.h"
+#include "graph.h"
+#include "stats.h"
 #include "default.h"
-
+#include "radix_sort.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include <boost/container/flat_set.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/container/static_vector.hpp>
 
 
+// thrown when a job is expected to need more memory than the budget allows
+struct BudgetExceeded : std::runtime_error {
+    BudgetExceeded(const std::string& message, float epsilon, int dim) :
+            std::runtime_error(message), epsilon(epsilon), dim(dim) {
+
+    }
+
+    // largest epsilon (in the requested dimension) and dimension (at the requested epsilon) that fit the budget
+    float epsilon;
+    int dim;
+};
+
+
+// thrown out of a computation when a stop was requested on its stop token
+struct Cancelled : std::runtime_error {
+    Cancelled() : std::runtime_error("The computation was cancelled") {
+
+    }
+};
+
+
+/*
+ * Progress of the current computation of a Compute. It is written by the thread that computes, and may be read by any
+ * other thread while it runs (the frontend shows it). The amount of items that were handled is only updated every so
+ * many items, and total is an estimate (0 if it is not known). If queries run concurrently, it is the progress of the
+ * one that reported last.
+ * */
+struct Progress {
+    enum class Phase {
+        Idle,
+        Simplices,
+        Collapse,
+        Morse,
+        Reduction,
+        Indices,
+    };
+
+    std::atomic<Phase> phase = Phase::Idle;
+    // dimension of the simplices that are handled
+    std::atomic<int> dim = 0;
+    std::atomic<u64> done = 0;
+    std::atomic<u64> total = 0;
+
+    void Start(Phase phase, int dim, u64 total = 0) {
+        this->phase.store(phase, std::memory_order_relaxed);
+        this->dim.store(dim, std::memory_order_relaxed);
+        this->done.store(0, std::memory_order_relaxed);
+        this->total.store(total, std::memory_order_relaxed);
+    }
+
+    static const char* PhaseName(Phase phase) {
+        switch (phase) {
+            case Phase::Idle: return "idle";
+            case Phase::Simplices: return "finding simplices";
+            case Phase::Collapse: return "collapsing edges";
+            case Phase::Morse: return "matching simplices";
+            case Phase::Reduction: return "reducing";
+            case Phase::Indices: return "drawing simplices";
+        }
+        return "unknown";
+    }
+};
+
+
 struct ComputeBase {
     using point_t = point_max;
 
-    ComputeBase(const std::vector<point_t>& points) : points(points) {
+    // predicted amount of simplices per dimension, and peak memory (in bytes) of the simplex cache and the B / Z matrices
+    struct SizeEstimate {
+        std::array<double, MAX_HOMOLOGY_DIM + 1> simplices{};
+        double memory = 0;
+    };
+
+    // simplices to draw in the order in which they appear, so that the simplices at any smaller epsilon are a prefix
+    struct DrawBuffers {
+        // all simplices up to this epsilon are in the buffers
+        float max_epsilon = 0;
+        // vertex indices of the simplices of every dimension up to 2 (we cannot draw 3-dimensional solids anyway)
+        boost::container::static_vector<std::vector<i32>, 3> indices{};
+        // filtration values of the simplices of every dimension that was asked for, in increasing order
+        boost::container::static_vector<std::vector<float>, MAX_HOMOLOGY_DIM + 1> values{};
+
+        // amount of n-simplices at an epsilon of at most max_epsilon
+        size_t Count(int n, float epsilon) const {
+            // the same bound as Compute::Bound
+            return std::upper_bound(values[n].begin(), values[n].end(), 4 * epsilon * epsilon) - values[n].begin();
+        }
+    };
+
+    // the bars of the barcode of one homology dimension up to max_epsilon, each with a cycle that represents it
+    // the cycles of the bars that are alive at any epsilon of at most max_epsilon are a basis of the homology there
+    struct HomologyBars {
+        float max_epsilon = 0;
+        // filtration values at which the bars are born and die (infinity if they are still alive at max_epsilon)
+        std::vector<std::pair<float, float>> bars{};
+        // vertex indices of the simplices in the cycles, the cycle of bar k runs from offsets[k] up to offsets[k + 1]
+        std::vector<i32> indices{};
+        std::vector<size_t> offsets{0};
+
+        // whether bar k is alive at an epsilon of at most max_epsilon
+        bool Alive(size_t k, float epsilon) const {
+            // the same bound as Compute::Bound
+            const float bound = 4 * epsilon * epsilon;
+            return bars[k].first <= bound && bound < bars[k].second;
+        }
+    };
+
+    ComputeBase(std::span<const point_t> points) : points(points) {
 
     }
 
     virtual ~ComputeBase() = default;
 
-    const std::vector<point_t>& points;
-    int current_simplices = 0;
+    const std::span<const point_t> points;
+
+    Progress progress{};
+
+    // the computation on this thread throws Cancelled soon after a stop is requested on this token (see Scheduler)
+    // it is only checked outside of parallel loops, so that it never throws out of a worker thread
+    static inline thread_local std::stop_token stop_token{};
+
+    // collapse dominated edges of the flag complex before computing a barcode (ignored for other filtrations)
+    bool collapse_edges = false;
+
+    // jobs that are expected to need more memory (in bytes) throw BudgetExceeded before finding any simplices
+    // 0 disables the check
+    size_t memory_budget = size_t{MEMORY_BUDGET_MB} << 20;
+
+    // wall time of the stages and counters of the work since the last barcode was started
+    Stats stats{};
+
+    // report that done items of the current phase were handled, and check whether the computation was cancelled
+    // this only does something every 256 items, so that it can be called for every simplex
+    void Step(u64 done) {
+        if ((done & 255) == 0) [[unlikely]] {
+            progress.done.store(done, std::memory_order_relaxed);
+            if (stop_token.stop_requested()) {
+                throw Cancelled{};
+            }
+        }
+    }
 
-    virtual boost::container::static_vector<std::vector<i32>, 3> FindSimplexDrawIndices(float epsilon, int n) = 0;
-    virtual std::pair<size_t, std::vector<i32>> FindHBasisDrawIndices(float epsilon, int n) = 0;
+    /*
+     * Finding draw buffers only searches for simplices and reads them (see SimplexCache), so it may run concurrently
+     * with one other query. The reductions (homology bars and barcodes) share their counters and arena, so only one
+     * of them may run at a time. A barcode with collapsed edges replaces the edges while it runs, so nothing may run
+     * alongside it.
+     * */
+    virtual SizeEstimate EstimateSize(float epsilon, int n) = 0;
+    virtual DrawBuffers FindSimplexDrawBuffers(float epsilon, int n) = 0;
+    virtual HomologyBars FindHomologyBars(float max_epsilon, int n) = 0;
+    virtual std::array<std::vector<std::pair<float, float>>, MAX_BARCODE_HOMOLOGY + 1> FindBarcode(float upper_bound) = 0;
 };
 
 
@@ -33,44 +191,135 @@ template<size_t N>
 struct Compute final : ComputeBase {
     using simplex_t = Simplex<N>;
     using column_t = Column<N>;
-    using basis_t = std::vector<std::pair<simplex_t, column_t>>;
+    using basis_t = std::vector<std::pair<simplex_t, column_t>, ArenaAllocator<std::pair<simplex_t, column_t>>>;
+    // hash map of a reduction, of which the nodes are allocated from its arena as well
+    template<class K, class V>
+    using arena_map_t = boost::unordered_map<K, V, boost::hash<K>, std::equal_to<K>, ArenaAllocator<std::pair<const K, V>>>;
+    // low -> (simplex, reduced column) for a basis of Z (see ReduceZBasis)
+    using reduced_t = arena_map_t<simplex_t, std::pair<simplex_t, column_t>>;
 
-    struct SimplexCache {
-        float max_epsilon = {};
-        boost::unordered_map<simplex_t, float> unordered{};
-    };
+    using cache_t = SimplexCache<N>;
 
-    Compute(const std::vector<point_t>& points) : ComputeBase(points) {
+    Compute(std::span<const point_t> points) : ComputeBase(points) {
+        FindEdgeValues({});
+    }
+
+    // use a precomputed (dense, row-major) matrix of squared distances between the points instead of
+    // their euclidean distances, for example the edge values of a witness complex on landmark points
+    Compute(std::span<const point_t> points, std::vector<float> distances) : ComputeBase(points) {
+        FindEdgeValues(std::move(distances));
+    }
+
+    // use a given filtration (for example an alpha complex) instead of the Vietoris Rips complex
+    // all of its simplices are known, so they are never searched for
+    Compute(std::span<const point_t> points, const Filtration& filtration) : ComputeBase(points), flag_complex(false) {
+        if constexpr(quantized) {
+            values = {0};
+            for (const auto& simplices : filtration.simplices) {
+                for (const auto& [dist, _] : simplices) {
+                    values.push_back(dist);
+                }
+            }
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+        }
 
+        for (int n = 1; n <= MAX_HOMOLOGY_DIM; n++) {
+            auto simplices = std::make_unique<typename cache_t::Snapshot>();
+            for (const auto& [dist, vertices] : filtration.simplices[n - 1]) {
+                simplex_t s{};
+                for (auto v : vertices) {
+                    if (v >= 0) s |= simplex_t{v};
+                }
+                simplices->Add(s, Rank(dist));
+            }
+            cache[n - 1].Reset(std::move(simplices), std::numeric_limits<float>::infinity());
+        }
     }
 
     ~Compute() final = default;
 
-    std::vector<SimplexCache> cache{};
+    // the n-simplices are in cache[n - 1]
+    std::array<cache_t, MAX_HOMOLOGY_DIM> cache{};
 
 
     template<size_t n, class F>
     void ForEachSimplex(float epsilon, bool ordered, const F& func);
 
-    // find simplex draw indices for frontend given for all dimensions lower than the given dimension
-    // and lower then 3 (we cannot draw 3-dimensional solids anyway
-    boost::container::static_vector<std::vector<i32>, 3> FindSimplexDrawIndices(float epsilon, int n) final;
+    // find the simplices up to the given dimension at epsilon for the frontend, ordered by their filtration values
+    DrawBuffers FindSimplexDrawBuffers(float epsilon, int n) final;
 
-    // find simplex draw indices for the basis of the homology group of the given dimension
-    std::pair<size_t, std::vector<i32>> FindHBasisDrawIndices(float epsilon, int n) final;
+    // find the bars of the homology group of the given dimension up to max_epsilon with their representative cycles
+    // for the frontend, so that the homology at any smaller epsilon can be drawn without reducing again
+    HomologyBars FindHomologyBars(float max_epsilon, int n) final;
 
-    // reduce a basis for Z to a basis of H given a basis for B
-    basis_t FindHBasis(const basis_t& B, const basis_t& Z) const;
+    // reduce the columns of a (labeled) basis for Z to unique lows, as low -> (label, column)
+    // the column with a low is a cycle that is born at that low
+    reduced_t ReduceZBasis(basis_t Z);
+
+    // find B - Z pairs for given B and Z (labeled) bases, with the cycle that is born at the Z simplex
+    // the columns of Z are reduced in place
+    std::vector<std::tuple<simplex_t, simplex_t, column_t>> FindBZBasisCycles(const basis_t& B, basis_t Z);
 
     // find B - Z pairs for given B and Z (labeled) bases
-    std::vector<std::pair<simplex_t, simplex_t>> FindBZBasisPairs(const basis_t& B, const basis_t& Z) const;
+    // the columns of Z are reduced in place
+    std::vector<std::pair<simplex_t, simplex_t>> FindBZBasisPairs(const basis_t& B, basis_t Z);
 
     // find a barcode given a range of epsilons
-    std::array<std::vector<std::pair<float, float>>, MAX_BARCODE_HOMOLOGY + 1> FindBarcode(float upper_bound);
+    std::array<std::vector<std::pair<float, float>>, MAX_BARCODE_HOMOLOGY + 1> FindBarcode(float upper_bound) final;
+
+    // estimate the size of a job that needs all simplices up to dimension n at epsilon, from a sample of the points
+    // (or from the simplices of a given filtration, which are all known)
+    SizeEstimate EstimateSize(float epsilon, int n) final;
+
+    // estimate the size of the flag complex of a graph up to dimension n at epsilon, like the one above
+    static SizeEstimate EstimateSize(const Graph& graph, float epsilon, int n);
+
+    // throw BudgetExceeded if finding the cliques of a graph up to dimension n at epsilon (Graph::FindFiltration) is
+    // expected to exceed the memory budget
+    static void Admit(const Graph& graph, float epsilon, int n, size_t memory_budget);
 
 private:
+    // columns and bases of a reduction are allocated from an arena that is released when the reduction ends
+    // while a ReductionArena exists, it is the one that new columns are allocated from
+    struct ReductionArena {
+        explicit ReductionArena(Compute& compute) : compute(compute), previous(compute.arena) {
+            compute.arena = &pool;
+        }
+
+        ~ReductionArena() {
+            compute.arena = previous;
+            compute.stats.bytes_allocated += pool.allocated;
+        }
+
+        ReductionArena(const ReductionArena&) = delete;
+        ReductionArena& operator=(const ReductionArena&) = delete;
+
+    private:
+        Compute& compute;
+        std::pmr::memory_resource* previous;
+        ColumnArena pool{};
+    };
+
+    // memory resource that new columns and bases are allocated from
+    std::pmr::memory_resource* arena = std::pmr::get_default_resource();
+
     template<size_t n>
-    std::vector<i32> FindSimplexDrawIndicesImpl(float epsilon);
+    void FindSimplexDrawBuffersImpl(float epsilon, DrawBuffers& buffers);
+
+    // throw BudgetExceeded if finding the simplices up to dimension n at epsilon is expected to exceed the memory budget
+    void Admit(float epsilon, int n);
+
+    // throw BudgetExceeded if estimate(epsilon, n) exceeds the memory budget, suggesting a smaller epsilon or dimension
+    template<class E>
+    static void Admit(float epsilon, int n, size_t memory_budget, const E& estimate);
+
+    // estimate the size of the flag complex up to dimension n from a sample of the vertices, given their neighbors
+    // (later only holds those with a higher index)
+    static SizeEstimate EstimateCliques(const std::vector<simplex_t>& neighbors, const std::vector<simplex_t>& later, int n);
+
+    // fill in the peak memory of an estimate from its amount of simplices up to dimension n
+    static void EstimateMemory(SizeEstimate& estimate, int n);
 
     // find the basis for B{0} and Z{1}
     // this is a special (optimized) method for the one below
@@ -80,10 +329,39 @@ private:
     template<int n>
     std::pair<basis_t, basis_t> FindBZn(float epsilon, bool ordered);
 
+    // find all n-simplices up to epsilon (and so all lower dimensional ones), if they were not found before
     template<size_t n>
     void FindnSimplices(float epsilon);
 
-    // find the distance between 2 points given their indices
+    // held while simplices are searched for (or replaced), so that there is only one thread that publishes them
+    std::mutex searching{};
+
+    // replace the 1-simplices by a filtration of the flag complex with the same persistent homology, in which
+    // dominated edges are inserted later or not at all (strong edge collapses)
+    // all higher dimensional simplices are then found from the reduced graph
+    void CollapseEdges(float epsilon);
+
+    // pair simplices by a discrete Morse matching (apparent pairs), only the unpaired (critical) simplices are reduced
+    void FindMorseMatching(float epsilon);
+
+    // morse[n - 1] maps the paired n-simplices to their partner (a facet or a cofacet)
+    // this is only set while computing a barcode, empty otherwise
+    std::vector<boost::unordered_map<simplex_t, simplex_t>> morse{};
+
+    // whether filtration values are ranks in values, instead of the values themselves
+    static constexpr bool quantized = std::is_integral_v<filtration_t>;
+
+    // filtration values of all edges (dense, row-major), only used for flag complexes
+    // replaced by the collapsed edges in CollapseEdges
+    std::vector<filtration_t> edge_values{};
+
+    // all distinct filtration values in increasing order, so value[rank] (only used if quantized)
+    std::vector<float> values{};
+
+    // whether the simplices are those of the flag complex of the edges (false for a given filtration)
+    bool flag_complex = true;
+
+    // find the (squared euclidean) distance between 2 points given their indices
     float Distance2(int i, int j) const {
         float dist = 0;
         for (int c = 0; c < point_t::dim; c++) {
@@ -93,15 +371,104 @@ private:
         return dist;
     }
 
+    // find the filtration value of the edge between 2 points given their indices
+    filtration_t EdgeValue(int i, int j) const {
+        return edge_values[i * points.size() + j];
+    }
+
+    // count a lookup, insertion or removal in a hash map (or the index of the simplex cache) in stats.hash_probes
+    template<class M>
+    M& Probe(M& map) {
+        stats.hash_probes++;
+        return map;
+    }
+
+    // filtration value of an n-simplex in the cache
+    // in a flag complex, this is the largest value of its edges, so we don't need to look it up
+    template<int n>
+    filtration_t ValueOf(const simplex_t& s) {
+        if constexpr(n == 0) {
+            return 0;
+        }
+        else {
+            if (!flag_complex) {
+                return Probe(cache[n - 1].Load()).At(s);
+            }
+            std::array<int, n + 1> vertices;
+            int count = 0;
+            s.ForEachPoint([&](int p) {
+                vertices[count++] = p;
+            });
+            filtration_t value = EdgeValue(vertices[0], vertices[1]);
+            for (int a = 0; a < n + 1; a++) {
+                for (int b = a + 1; b < n + 1; b++) {
+                    value = std::max(value, EdgeValue(vertices[a], vertices[b]));
+                }
+            }
+            return value;
+        }
+    }
+
+    // rank of a filtration value, which has to be in values
+    filtration_t Rank(float value) const {
+        if constexpr(quantized) {
+            return std::lower_bound(values.begin(), values.end(), value) - values.begin();
+        }
+        else {
+            return value;
+        }
+    }
+
+    // filtration value of a rank
+    float Value(filtration_t rank) const {
+        if constexpr(quantized) {
+            return values[rank];
+        }
+        else {
+            return rank;
+        }
+    }
+
+    // largest filtration value that is in the complex at epsilon, simplices are in the complex if their
+    // filtration value is at most this
+    filtration_t Bound(float epsilon) const {
+        if constexpr(quantized) {
+            // values always holds 0, so there is at least one value that is at most 4 * epsilon * epsilon
+            const auto count = std::upper_bound(values.begin(), values.end(), 4 * epsilon * epsilon) - values.begin();
+            return std::max<ptrdiff_t>(count, 1) - 1;
+        }
+        else {
+            return 4 * epsilon * epsilon;
+        }
+    }
+
+    // find the filtration values of all edges from the given squared distances between the points (or their
+    // euclidean distances if there are none), if quantized this finds values and ranks the edges in it
+    void FindEdgeValues(std::vector<float> distances);
+
+    // record the amount of n-simplices in the cache as a counter in the trace
+    void TraceCacheSize(int n) const {
+        if (trace::enabled.load(std::memory_order_relaxed)) [[unlikely]] {
+            trace::Counter("simplex cache " + std::to_string(n), cache[n - 1].Load().size());
+        }
+    }
+
+    // add other to column in a reduction
+    void AddColumn(column_t& column, const column_t& other) {
+        column ^= other;
+        stats.column_additions++;
+        stats.peak_column_length = std::max<u64>(stats.peak_column_length, column.data.size());
+    }
+
     template<int n>
     Column<N> BoundaryOf(simplex_t s) {
-        Column<N> result{};
+        stats.boundaries++;
+        Column<N> result{arena};
         s.ForEachPoint([&](int p) {
             // insert all n - 1 simplices by iterating over every point and removing it
             if constexpr(n > 1) {
-                // we need to find the right max_dist too, this is probably faster than calculating it
-                float dist = cache[n - 2].unordered.at(s ^ simplex_t{p});
-                result.data.emplace(dist, s ^ simplex_t{p});
+                const auto face = s ^ simplex_t{p};
+                result.data.emplace(ValueOf<n - 1>(face), face);
             }
             else {
                 // for 1-simplices, the boundary consists of 0-simplices with 0 max_dist
@@ -110,6 +477,33 @@ private:
         });
         return result;
     }
+
+    // boundary of a critical simplex in the Morse complex: facets that are paired with a cofacet are replaced by
+    // the rest of the boundary of that cofacet (youngest first), facets paired with a facet of their own vanish
+    template<int n>
+    Column<N> MorseBoundaryOf(simplex_t s) {
+        Column<N> boundary = BoundaryOf<n>(s);
+        std::vector<std::pair<filtration_t, simplex_t>> critical{};
+        while (boundary) {
+            const auto youngest = std::prev(boundary.data.end());
+            const auto match = Probe(morse[n - 2]).find(youngest->second);
+            if (match == morse[n - 2].end()) {
+                critical.push_back(*youngest);
+                boundary.data.erase(youngest);
+            }
+            else if (match->second.Count() == n + 1) {
+                // all other facets of the partner are older, so this terminates
+                AddColumn(boundary, BoundaryOf<n>(match->second));
+            }
+            else {
+                boundary.data.erase(youngest);
+            }
+        }
+
+        Column<N> result{arena};
+        result.data.insert(boost::container::ordered_unique_range, critical.rbegin(), critical.rend());
+        return result;
+    }
 };
 
 template<size_t N>
@@ -119,53 +513,70 @@ void Compute<N>::FindnSimplices(float epsilon) {
         return;
     }
 
-    if (cache.size() < n) {
-        cache.resize(n);
+    if (epsilon <= cache[n - 1].Load().max_epsilon) {
+        return;
+    }
+    if constexpr(n > 1) {
+        FindnSimplices<n - 1>(epsilon);
     }
 
-    if (epsilon <= cache[n - 1].max_epsilon) {
+    // only one search at a time, another query may have found the simplices while we waited for it
+    std::lock_guard lock{searching};
+    const auto& found = cache[n - 1].Load();
+    const float prev_epsilon = found.max_epsilon;
+    if (epsilon <= prev_epsilon) {
         return;
     }
-    const float prev_epsilon = cache[n - 1].max_epsilon;
-    cache[n - 1].max_epsilon = std::max(prev_epsilon, epsilon);
+    const filtration_t bound = Bound(epsilon);
+
+    // every simplex is generated exactly once per search, so we only append the ones that were not found before
+    // (nothing was found before if prev_epsilon is still 0)
+    const filtration_t prev_bound = Bound(prev_epsilon);
+    auto is_new = [&](filtration_t dist) {
+        return prev_epsilon <= 0 || dist > prev_bound;
+    };
 
+    StageTimer timer{stats, "simplices " + std::to_string(n)};
+    // if the search is cancelled, what it found is never published, so that the next search finds it again
+    auto simplices = std::make_unique<typename cache_t::Snapshot>();
     // 1 simplices are special since we can use them for the higher order simplices
     if constexpr(n == 1) {
-        auto& unordered_simplices = cache[0].unordered;
-
+        progress.Start(Progress::Phase::Simplices, 1, points.size());
         for (int i = 0; i < points.size(); i++) {
+            Step(i);
             for (int j = i + 1; j < points.size(); j++) {
-                const float dist2 = Distance2(i, j);
-                if (dist2 <= 4 * epsilon * epsilon) {
-                    auto s = simplex_t{i, j};
-                    unordered_simplices.emplace(s, dist2);
+                const filtration_t dist2 = EdgeValue(i, j);
+                if (dist2 <= bound && is_new(dist2)) {
+                    simplices->Add(simplex_t{i, j}, dist2);
                 }
             }
         }
     }
     else {
-        auto& unordered_simplices = cache[n - 1].unordered;
-
-        FindnSimplices<n - 1>(epsilon);
-
-        for (const auto [s, max_dist] : cache[n - 2].unordered) {
+        const auto& faces = cache[n - 2].Load();
+        progress.Start(Progress::Phase::Simplices, n, faces.size());
+        u64 done = 0;
+        faces.ForEach([&](const simplex_t& s, filtration_t max_dist) {
+            Step(done++);
             // try every other point
             for (int i = s.FindHigh() + 1; i < points.size(); i++) {
                 const auto next = s | simplex_t{i};
-                float dist = max_dist;
+                filtration_t dist = max_dist;
                 if (!s.ForEachPoint([&](int p) -> bool {
                     // check whether there is a 1-simplex for every point in the simplex
-                    dist = std::max(dist, Distance2(i, p));
-                    if (dist > 4 * epsilon * epsilon) {
+                    dist = std::max(dist, EdgeValue(i, p));
+                    if (dist > bound) {
                         return true;  // bad simplex, 1-simplex does not exist
                     }
                     return false;  // keep going, 1-simplex exists for this point
-                })) {
-                    unordered_simplices.emplace(next, dist);
+                }) && is_new(dist)) {
+                    simplices->Add(next, dist);
                 }
             }
-        }
+        });
     }
+    cache[n - 1].Publish(std::move(simplices), epsilon);
+    TraceCacheSize(n);
 }
 
 template<size_t N>
@@ -179,24 +590,79 @@ void Compute<N>::ForEachSimplex(float epsilon, bool ordered, const F& func) {
         }
     }
     else {
+        // finding the simplices is a phase of its own, after which we continue with the phase of the caller
+        const auto phase = progress.phase.load(std::memory_order_relaxed);
+        const int dim = progress.dim.load(std::memory_order_relaxed);
         FindnSimplices<n>(epsilon);
+        // a later search may publish more simplices, but this one has all simplices up to epsilon
+        const auto& simplices = cache[n - 1].Load();
+        progress.Start(phase, dim, simplices.size());
+        u64 done = 0;
+        const filtration_t bound = Bound(epsilon);
         if (ordered) {
-          boost::container::flat_set<std::pair<float, simplex_t>> ordered_simplices{};
-          ordered_simplices.reserve(cache[n - 1].unordered.size());
-          for (const auto& [simplex, dist] : cache[n - 1].unordered) {
-              ordered_simplices.emplace(dist, simplex);
-          }
-          for (const auto& [dist, simplex] : ordered_simplices) {
-              if (dist > 4 * epsilon * epsilon) break;
-              func(dist, simplex);
-          }
+            constexpr int vertex_bits = std::bit_width(N - 1);
+            if constexpr((n + 1) * vertex_bits <= 64) {
+                /*
+                 * The vertices of the simplices (in increasing order) are packed into a single integer, which then
+                 * compares like the simplices themselves. A radix sort by these keys, and then (stably) by the
+                 * filtration values, gives the same order as sorting std::pair<filtration_t, simplex_t>.
+                 * */
+                struct SortKey {
+                    u64 vertices;
+                    filtration_t value;
+                };
+                std::vector<SortKey> keys{};
+                std::optional<StageTimer> timer{std::in_place, stats, "order " + std::to_string(n)};
+                keys.reserve(simplices.size());
+                simplices.ForEach([&](const simplex_t& simplex, filtration_t dist) {
+                    if (dist <= bound) {
+                        u64 vertices = 0;
+                        for (int i = 0; i < simplex.points.size(); i++) {
+                            for (u64 section = simplex.points[i]; section; section &= section - 1) {
+                                vertices = (vertices << vertex_bits) | (i * simplex_t::bits + std::countr_zero(section));
+                            }
+                        }
+                        keys.push_back({vertices, dist});
+                    }
+                });
+                detail::radix_sort(keys, [](const SortKey& key) { return key.vertices; }, (n + 1) * vertex_bits);
+                detail::radix_sort(keys, [](const SortKey& key) { return detail::radix_key(key.value); }, 32);
+                timer.reset();
+
+                progress.total.store(keys.size(), std::memory_order_relaxed);
+                for (const auto& [vertices, dist] : keys) {
+                    Step(done++);
+                    simplex_t simplex{};
+                    for (int i = 0; i <= n; i++) {
+                        simplex |= simplex_t{(int)((vertices >> (i * vertex_bits)) & ((1ull << vertex_bits) - 1))};
+                    }
+                    func(dist, simplex);
+                }
+            }
+            else {
+                std::optional<StageTimer> timer{std::in_place, stats, "order " + std::to_string(n)};
+                std::vector<std::pair<filtration_t, simplex_t>> ordered_simplices{};
+                simplices.ForEach([&](const simplex_t& simplex, filtration_t dist) {
+                    if (dist <= bound) {
+                        ordered_simplices.emplace_back(dist, simplex);
+                    }
+                });
+                std::sort(ordered_simplices.begin(), ordered_simplices.end());
+                timer.reset();
+                progress.total.store(ordered_simplices.size(), std::memory_order_relaxed);
+                for (const auto& [dist, simplex] : ordered_simplices) {
+                    Step(done++);
+                    func(dist, simplex);
+                }
+            }
         }
         else {
-            for (const auto& [simplex, dist] : cache[n - 1].unordered) {
-                if (dist <= 4 * epsilon * epsilon) {
+            simplices.ForEach([&](const simplex_t& simplex, filtration_t dist) {
+                Step(done++);
+                if (dist <= bound) {
                     func(dist, simplex);
                 }
-            }
+            });
         }
     }
 }
\ No newline at end of file
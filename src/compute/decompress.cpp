@@ -0,0 +1,181 @@
+#include "decompress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+
+Decompressor::Format Decompressor::Detect(const char* data, size_t size) {
+    if (size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b) {
+        return Format::Gzip;
+    }
+    if (size >= 4 && std::memcmp(data, "\x28\xb5\x2f\xfd", 4) == 0) {
+        return Format::Zstd;
+    }
+    return Format::None;
+}
+
+Decompressor::Decompressor(const char* data, size_t size, Format format) : data(data), size(size), format(format) {
+#ifndef WITH_ZLIB
+    if (format == Format::Gzip) throw std::runtime_error("Cannot read gzip compressed files, rebuild with zlib");
+#endif
+#ifndef WITH_ZSTD
+    if (format == Format::Zstd) throw std::runtime_error("Cannot read zstd compressed files, rebuild with zstd");
+#endif
+    worker = std::thread(&Decompressor::Run, this);
+}
+
+Decompressor::~Decompressor() {
+    {
+        std::lock_guard lock(mutex);
+        stopped = true;
+    }
+    consumed.notify_all();
+    worker.join();
+}
+
+std::vector<char> Decompressor::Next() {
+    std::unique_lock lock(mutex);
+    produced.wait(lock, [&] { return !blocks.empty() || done; });
+    if (blocks.empty()) {
+        if (error) std::rethrow_exception(error);
+        return {};
+    }
+    std::vector<char> block = std::move(blocks.front());
+    blocks.pop_front();
+    lock.unlock();
+    consumed.notify_one();
+    return block;
+}
+
+bool Decompressor::Push(std::vector<char>&& block) {
+    std::unique_lock lock(mutex);
+    consumed.wait(lock, [&] { return blocks.size() < MaxBlocks || stopped; });
+    if (stopped) {
+        return false;
+    }
+    blocks.push_back(std::move(block));
+    lock.unlock();
+    produced.notify_one();
+    return true;
+}
+
+void Decompressor::Run() {
+    try {
+        if (format == Format::Gzip) DecompressGzip();
+        else if (format == Format::Zstd) DecompressZstd();
+    }
+    catch (...) {
+        std::lock_guard lock(mutex);
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard lock(mutex);
+        done = true;
+    }
+    produced.notify_all();
+}
+
+void Decompressor::DecompressGzip() {
+#ifdef WITH_ZLIB
+    z_stream stream{};
+    // 15 window bits, + 32 to detect the gzip header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        throw std::runtime_error("Failed to initialize gzip decompression");
+    }
+    auto fail = [&](const char* message) {
+        inflateEnd(&stream);
+        throw std::runtime_error(message);
+    };
+
+    // zlib takes its input in pieces of at most 4 GB
+    auto input = reinterpret_cast<const unsigned char*>(data);
+    size_t remaining = size;
+    std::vector<char> block(BlockSize);
+    size_t filled = 0;
+    while (true) {
+        if (stream.avail_in == 0 && remaining > 0) {
+            stream.next_in = const_cast<unsigned char*>(input);
+            stream.avail_in = (uInt)std::min<size_t>(remaining, 1u << 30);
+            input += stream.avail_in;
+            remaining -= stream.avail_in;
+        }
+        stream.next_out = reinterpret_cast<unsigned char*>(block.data() + filled);
+        stream.avail_out = (uInt)(block.size() - filled);
+
+        const int status = inflate(&stream, Z_NO_FLUSH);
+        filled = block.size() - stream.avail_out;
+        if (status == Z_STREAM_END) {
+            // a gzip file can consist of several members after another
+            if (stream.avail_in == 0 && remaining == 0) break;
+            inflateReset(&stream);
+        }
+        else if (status == Z_BUF_ERROR) {
+            // there is room for output, so the input ended in the middle of the stream
+            fail("Truncated gzip data");
+        }
+        else if (status != Z_OK) {
+            fail("Corrupt gzip data");
+        }
+
+        if (filled == block.size()) {
+            if (!Push(std::move(block))) {
+                inflateEnd(&stream);
+                return;
+            }
+            block = std::vector<char>(BlockSize);
+            filled = 0;
+        }
+    }
+    inflateEnd(&stream);
+    block.resize(filled);
+    if (!block.empty()) Push(std::move(block));
+#endif
+}
+
+void Decompressor::DecompressZstd() {
+#ifdef WITH_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+
+    ZSTD_inBuffer input{data, size, 0};
+    std::vector<char> block(BlockSize);
+    ZSTD_outBuffer output{block.data(), block.size(), 0};
+    size_t hint = 0;
+    while (true) {
+        hint = ZSTD_decompressStream(stream, &output, &input);
+        if (ZSTD_isError(hint)) {
+            ZSTD_freeDStream(stream);
+            throw std::runtime_error(std::string("Corrupt zstd data: ") + ZSTD_getErrorName(hint));
+        }
+        if (output.pos == output.size) {
+            // the decoder may have more output, even if all input is used
+            if (!Push(std::move(block))) {
+                ZSTD_freeDStream(stream);
+                return;
+            }
+            block = std::vector<char>(BlockSize);
+            output = {block.data(), block.size(), 0};
+        }
+        else if (input.pos == input.size) {
+            break;
+        }
+    }
+    ZSTD_freeDStream(stream);
+
+    // the decoder is still waiting for the rest of a frame
+    if (hint != 0) {
+        throw std::runtime_error("Truncated zstd data");
+    }
+    block.resize(output.pos);
+    if (!block.empty()) Push(std::move(block));
+#endif
+}
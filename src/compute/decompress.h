@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Streaming decompression of gzip or zstd compressed data (for example a memory mapped file) in a background thread.
+ * The decompressed data is handed out in blocks through a bounded queue, so only a few blocks are ever in memory,
+ * and the consumer can work on one block while the next ones are decompressed.
+ * Support for both formats is optional, it depends on whether zlib (WITH_ZLIB) and zstd (WITH_ZSTD) were found.
+ * */
+
+struct Decompressor {
+    enum class Format {
+        None,
+        Gzip,
+        Zstd,
+    };
+
+    // detect the compression of some data from its magic number
+    static Format Detect(const char* data, size_t size);
+
+    Decompressor(const char* data, size_t size, Format format);
+    ~Decompressor();
+
+    Decompressor(const Decompressor&) = delete;
+    Decompressor& operator=(const Decompressor&) = delete;
+
+    // the next block of decompressed data, empty at the end of the stream
+    // errors in the background thread are rethrown here
+    std::vector<char> Next();
+
+private:
+    static constexpr size_t BlockSize = 8 << 20;
+    static constexpr size_t MaxBlocks = 4;
+
+    const char* data;
+    size_t size;
+    Format format;
+
+    std::mutex mutex{};
+    std::condition_variable produced{};
+    std::condition_variable consumed{};
+    std::deque<std::vector<char>> blocks{};
+    bool done = false;
+    bool stopped = false;
+    std::exception_ptr error{};
+    std::thread worker;
+
+    void Run();
+    void DecompressGzip();
+    void DecompressZstd();
+
+    // hand a full block to the consumer, waits while the queue is full
+    // returns false if the consumer stopped
+    bool Push(std::vector<char>&& block);
+};
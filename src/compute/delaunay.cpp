@@ -0,0 +1,286 @@
+#include "delaunay.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+
+template<int D>
+Delaunay<D>::Delaunay(std::span<const point_max> points) {
+    coords.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        for (int c = 0; c < D; c++) {
+            coords[i][c] = points[i][c];
+        }
+    }
+
+    // coinciding points cannot be triangulated, we only keep the first one
+    std::vector<i32> order{};
+    order.reserve(points.size());
+    boost::unordered_map<point_t, i32> seen{};
+    for (i32 i = 0; i < (i32)coords.size(); i++) {
+        const auto [it, inserted] = seen.emplace(coords[i], i);
+        if (inserted) order.push_back(i);
+        else duplicates.emplace_back(i, it->second);
+    }
+
+    if (!InitialCell(order)) {
+        throw std::runtime_error("Points lie in a lower dimensional subspace, cannot find Delaunay triangulation");
+    }
+    for (i32 p : order) {
+        Insert(p);
+    }
+}
+
+template<int D>
+std::vector<typename Delaunay<D>::cell_t> Delaunay<D>::FindCells() const {
+    std::vector<cell_t> result{};
+    for (const auto& cell : cells) {
+        if (!cell.alive || std::find(cell.vertices.begin(), cell.vertices.end(), infinite) != cell.vertices.end()) {
+            continue;
+        }
+        cell_t vertices = cell.vertices;
+        std::sort(vertices.begin(), vertices.end());
+        result.push_back(vertices);
+    }
+    return result;
+}
+
+template<int D>
+int Delaunay<D>::Orient(const cell_t& vertices) const {
+    std::array<const point_t*, D + 1> p;
+    for (int i = 0; i <= D; i++) {
+        p[i] = &coords[vertices[i]];
+    }
+    return Predicates<D>::Orient(p);
+}
+
+template<int D>
+bool Delaunay<D>::InitialCell(std::vector<i32>& order) {
+    // find D + 1 affinely independent points, and remove them from the insertion order
+    cell_t initial;
+    std::vector<size_t> used{};
+    for (size_t k = 0; k < order.size() && used.size() <= D; k++) {
+        const i32 p = order[k];
+        const size_t m = used.size();
+        bool independent = true;
+        if (m == D) {
+            initial[m] = p;
+            independent = Orient(initial) != 0;
+        }
+        else if (m == 2) {
+            // three points in 3D are not collinear if any of their projections onto the coordinate planes is not
+            independent = false;
+            for (auto [x, y] : {std::pair{0, 1}, std::pair{1, 2}, std::pair{0, 2}}) {
+                std::array<Predicates<2>::point_t, 3> projected{};
+                for (int i = 0; i < 3; i++) {
+                    const auto& point = coords[i < 2 ? initial[i] : p];
+                    projected[i] = {point[x], point[y]};
+                }
+                if (Predicates<2>::Orient({&projected[0], &projected[1], &projected[2]}) != 0) {
+                    independent = true;
+                    break;
+                }
+            }
+        }
+        if (independent) {
+            initial[m] = p;
+            used.push_back(k);
+        }
+    }
+    if (used.size() <= D) {
+        return false;
+    }
+    for (auto it = used.rbegin(); it != used.rend(); it++) {
+        order.erase(order.begin() + *it);
+    }
+
+    if (Orient(initial) < 0) {
+        std::swap(initial[0], initial[1]);
+    }
+    cells.push_back({initial});
+    cells[0].neighbors.fill(-1);
+
+    // one infinite cell for every facet, we swap two vertices since the infinite vertex is on the other side
+    for (int i = 0; i <= D; i++) {
+        Cell cell{initial};
+        cell.vertices[i] = infinite;
+        const int a = (i == 0) ? 1 : 0;
+        const int b = (i <= 1) ? 2 : 1;
+        std::swap(cell.vertices[a], cell.vertices[b]);
+        cell.neighbors.fill(-1);
+        cells.push_back(cell);
+    }
+
+    std::vector<i32> all(cells.size());
+    for (i32 c = 0; c < (i32)cells.size(); c++) all[c] = c;
+    LinkFacets(all);
+    last = 0;
+    return true;
+}
+
+template<int D>
+bool Delaunay<D>::InConflict(i32 cell, i32 p) const {
+    const auto& vertices = cells[cell].vertices;
+    const auto inf = std::find(vertices.begin(), vertices.end(), infinite);
+    if (inf == vertices.end()) {
+        std::array<const point_t*, D + 2> points;
+        std::array<i32, D + 2> indices;
+        for (int i = 0; i <= D; i++) {
+            points[i] = &coords[vertices[i]];
+            indices[i] = vertices[i];
+        }
+        points[D + 1] = &coords[p];
+        indices[D + 1] = p;
+        return Predicates<D>::InSpherePerturbed(points, indices) > 0;
+    }
+
+    // an infinite cell is in conflict with points on the outside of its hull facet
+    // points in the plane of the facet are in conflict if they are in its circumsphere, which happens
+    // exactly when the finite cell on the other side of the facet is in conflict
+    const int index = inf - vertices.begin();
+    cell_t replaced = vertices;
+    replaced[index] = p;
+    const int orient = Orient(replaced);
+    if (orient != 0) {
+        return orient > 0;
+    }
+    return InConflict(cells[cell].neighbors[index], p);
+}
+
+template<int D>
+i32 Delaunay<D>::Locate(i32 p) {
+    /*
+     * Walk from the last inserted cell towards p, through a facet that p lies beyond (starting from a
+     * pseudo-random facet so that the walk cannot cycle). This ends in the finite cell that contains p,
+     * which is in conflict, or in the infinite cell of a hull facet that p lies beyond.
+     * */
+    i32 current = last;
+    i32 previous = -1;
+    for (size_t step = 0; step < cells.size(); step++) {
+        const Cell& cell = cells[current];
+        const auto inf = std::find(cell.vertices.begin(), cell.vertices.end(), infinite);
+        if (inf != cell.vertices.end()) {
+            if (InConflict(current, p)) {
+                return current;
+            }
+            previous = current;
+            current = cell.neighbors[inf - cell.vertices.begin()];
+            continue;
+        }
+
+        rng = rng * 1664525u + 1013904223u;
+        const int start = (rng >> 16) % (D + 1);
+        i32 next = -1;
+        for (int k = 0; k <= D; k++) {
+            const int i = (start + k) % (D + 1);
+            if (cell.neighbors[i] == previous) continue;
+            cell_t replaced = cell.vertices;
+            replaced[i] = p;
+            if (Orient(replaced) < 0) {
+                next = cell.neighbors[i];
+                break;
+            }
+        }
+        if (next < 0) {
+            if (InConflict(current, p)) {
+                return current;
+            }
+            break;
+        }
+        previous = current;
+        current = next;
+    }
+
+    // this should not happen, but a linear search always works
+    for (i32 c = 0; c < (i32)cells.size(); c++) {
+        if (cells[c].alive && InConflict(c, p)) {
+            return c;
+        }
+    }
+    throw std::runtime_error("Could not locate point in Delaunay triangulation");
+}
+
+template<int D>
+void Delaunay<D>::Insert(i32 p) {
+    // find all cells whose circumsphere contains p, these form a connected (star shaped) cavity around p
+    const i32 start = Locate(p);
+    marks.resize(cells.size(), 0);
+    std::vector<i32> cavity{start};
+    std::vector<i32> touched{start};
+    marks[start] = 1;
+    for (size_t k = 0; k < cavity.size(); k++) {
+        for (i32 neighbor : cells[cavity[k]].neighbors) {
+            if (marks[neighbor] == 0) {
+                marks[neighbor] = InConflict(neighbor, p) ? 1 : 2;
+                touched.push_back(neighbor);
+                if (marks[neighbor] == 1) {
+                    cavity.push_back(neighbor);
+                }
+            }
+        }
+    }
+
+    // connect every boundary facet of the cavity to p
+    std::vector<i32> new_cells{};
+    for (i32 c : cavity) {
+        const Cell old = cells[c];
+        for (int i = 0; i <= D; i++) {
+            const i32 neighbor = old.neighbors[i];
+            if (marks[neighbor] != 2) continue;
+
+            const i32 index = cells.size();
+            Cell cell{old.vertices};
+            cell.vertices[i] = p;
+            cell.neighbors.fill(-1);
+            cell.neighbors[i] = neighbor;
+            for (auto& back : cells[neighbor].neighbors) {
+                if (back == c) back = index;
+            }
+            cells.push_back(cell);
+            new_cells.push_back(index);
+        }
+    }
+
+    for (i32 c : touched) {
+        marks[c] = 0;
+    }
+    for (i32 c : cavity) {
+        cells[c].alive = false;
+    }
+    LinkFacets(new_cells);
+    last = new_cells.back();
+}
+
+template<int D>
+void Delaunay<D>::LinkFacets(const std::vector<i32>& new_cells) {
+    // link the facets of the given cells that have no neighbor yet, by their (sorted) vertices
+    boost::unordered_map<std::array<i32, D>, std::pair<i32, int>> open{};
+    for (i32 c : new_cells) {
+        for (int k = 0; k <= D; k++) {
+            if (cells[c].neighbors[k] != -1) continue;
+
+            std::array<i32, D> facet;
+            for (int i = 0, j = 0; i <= D; i++) {
+                if (i != k) facet[j++] = cells[c].vertices[i];
+            }
+            std::sort(facet.begin(), facet.end());
+
+            const auto it = open.find(facet);
+            if (it == open.end()) {
+                open.emplace(facet, std::pair{c, k});
+            }
+            else {
+                const auto [other, other_k] = it->second;
+                cells[c].neighbors[k] = other;
+                cells[other].neighbors[other_k] = c;
+                open.erase(it);
+            }
+        }
+    }
+}
+
+
+template struct Delaunay<2>;
+template struct Delaunay<3>;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "point.h"
+#include "predicates.h"
+#include "default.h"
+
+#include <array>
+#include <span>
+#include <vector>
+
+/*
+ * Delaunay triangulation of the first D coordinates of a point cloud, by incremental (Bowyer-Watson) insertion.
+ * The convex hull is closed off with "infinite" cells, which connect every hull facet to a single vertex at infinity,
+ * so that points outside the hull are inserted in exactly the same way as points inside it.
+ * All predicates are exact, and cospherical points are handled by a symbolic perturbation, so the result is
+ * always a valid triangulation.
+ * */
+
+template<int D>
+struct Delaunay {
+    using point_t = typename Predicates<D>::point_t;
+    using cell_t = std::array<i32, D + 1>;
+
+    Delaunay(std::span<const point_max> points);
+
+    // all finite cells, by their (sorted) vertex indices
+    std::vector<cell_t> FindCells() const;
+
+    // points that coincide with an earlier point are not part of the triangulation, as (duplicate, original) pairs
+    std::vector<std::pair<i32, i32>> duplicates{};
+
+private:
+    static constexpr i32 infinite = -1;
+
+    struct Cell {
+        // the cell is positively oriented, for infinite cells this means that replacing the infinite vertex
+        // by a point on the outside of its hull facet gives a positively oriented simplex
+        cell_t vertices;
+        // neighbors[i] is the cell opposite of vertices[i]
+        std::array<i32, D + 1> neighbors;
+        bool alive = true;
+    };
+
+    std::vector<point_t> coords;
+    std::vector<Cell> cells{};
+
+    // conflict state of the cells during an insertion (0: unknown, 1: conflict, 2: no conflict)
+    std::vector<u8> marks{};
+    i32 last = 0;
+    u32 rng = 1;
+
+    bool InitialCell(std::vector<i32>& order);
+    void Insert(i32 p);
+    i32 Locate(i32 p);
+    bool InConflict(i32 cell, i32 p) const;
+    int Orient(const cell_t& vertices) const;
+    void LinkFacets(const std::vector<i32>& new_cells);
+};
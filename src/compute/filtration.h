@@ -0,0 +1,20 @@
+#pragma once
+
+#include "default.h"
+
+#include <array>
+#include <vector>
+
+/*
+ * A filtration that is given by its simplices, instead of one found from the distances between the points (like the
+ * Vietoris Rips complex). simplices[n - 1] holds the n-simplices by their vertices (unused vertices are -1) and their
+ * filtration value, in the same units as Compute::Distance2 (so they are compared against 4 * epsilon * epsilon).
+ * The 0-simplices are always all points at value 0, and every face of a simplex must be in the filtration too,
+ * with a value that is not larger.
+ * */
+
+struct Filtration {
+    using vertices_t = std::array<i32, MAX_HOMOLOGY_DIM + 1>;
+
+    std::array<std::vector<std::pair<float, vertices_t>>, MAX_HOMOLOGY_DIM> simplices{};
+};
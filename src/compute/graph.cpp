@@ -0,0 +1,73 @@
+#include "graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+Graph::Graph(std::vector<Edge> edges) : edges(std::move(edges)) {
+    for (const auto& edge : this->edges) {
+        if (edge.a < 0 || edge.b < 0) {
+            throw std::runtime_error("Edges must be between non-negative point indices");
+        }
+        vertices = std::max<size_t>(vertices, std::max(edge.a, edge.b) + 1);
+    }
+}
+
+Filtration Graph::FindFiltration(float max_epsilon) const {
+    const float max_value = 4 * max_epsilon * max_epsilon;
+
+    // for every vertex, its neighbors with a larger index (sorted) and the squared length of the edge to them
+    // an edge that is given more than once is kept at its smallest distance, loops are ignored
+    std::vector<std::vector<std::pair<i32, float>>> up(vertices);
+    for (const auto [a, b, distance] : edges) {
+        const float value = distance * distance;
+        if (a == b || !(value <= max_value)) continue;
+        up[std::min(a, b)].emplace_back(std::max(a, b), value);
+    }
+    for (auto& neighbors : up) {
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end(), [](const auto& l, const auto& r) {
+            return l.first == r.first;
+        }), neighbors.end());
+    }
+
+    /*
+     * Every clique is found exactly once, from its smallest vertex, by extending it with the vertices that are
+     * larger than all of its vertices and adjacent to all of them (the candidates). Every candidate keeps the
+     * largest edge value between it and the clique, so that the value of the extended clique is known right away.
+     * */
+    Filtration result{};
+    Filtration::vertices_t clique;
+    clique.fill(-1);
+
+    auto extend = [&](auto& self, int k, float value, const std::vector<std::pair<i32, float>>& candidates) -> void {
+        for (size_t i = 0; i < candidates.size(); i++) {
+            const auto [v, to_clique] = candidates[i];
+            const float extended = std::max(value, to_clique);
+            clique[k + 1] = v;
+            result.simplices[k].emplace_back(extended, clique);
+
+            if (k + 1 < MAX_HOMOLOGY_DIM) {
+                // candidates after v that are also adjacent to v (both lists are sorted)
+                std::vector<std::pair<i32, float>> next{};
+                auto neighbor = up[v].begin();
+                for (size_t j = i + 1; j < candidates.size() && neighbor != up[v].end(); j++) {
+                    while (neighbor != up[v].end() && neighbor->first < candidates[j].first) neighbor++;
+                    if (neighbor != up[v].end() && neighbor->first == candidates[j].first) {
+                        next.emplace_back(candidates[j].first, std::max(candidates[j].second, neighbor->second));
+                    }
+                }
+                if (!next.empty()) {
+                    self(self, k + 1, extended, next);
+                }
+            }
+            clique[k + 1] = -1;
+        }
+    };
+
+    for (i32 v = 0; v < (i32)vertices; v++) {
+        clique[0] = v;
+        extend(extend, 0, 0, up[v]);
+    }
+    return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "filtration.h"
+#include "default.h"
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * A sparse weighted graph on the points, for data that is not given by coordinates (geodesic distances,
+ * correlation distances, ...). Its filtration is the flag complex of the graph: an edge appears at its distance
+ * (so at epsilon = distance / 2, just like for points), and higher dimensional simplices appear as soon as
+ * all their edges have. Points that are not joined by an edge are never joined.
+ * */
+
+struct Graph {
+    struct Edge {
+        i32 a;
+        i32 b;
+        float distance;
+    };
+
+    // the graph has as many vertices as the largest index in its edges (plus one)
+    Graph(std::vector<Edge> edges);
+
+    size_t vertices = 0;
+    std::vector<Edge> edges;
+
+    // find the flag complex up to MAX_HOMOLOGY_DIM by enumerating the cliques of the edges that appear before max_epsilon
+    Filtration FindFiltration(float max_epsilon) const;
+};
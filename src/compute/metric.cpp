@@ -0,0 +1,109 @@
+#include "metric.h"
+
+#include "parallel.h"
+
+#include <numeric>
+#include <stdexcept>
+
+
+Metric ParseMetric(const std::string& name) {
+    if (name == "euclidean") return Metric::Euclidean;
+    if (name == "manhattan") return Metric::Manhattan;
+    if (name == "chebyshev") return Metric::Chebyshev;
+    if (name == "cosine") return Metric::Cosine;
+    if (name == "mahalanobis") return Metric::Mahalanobis;
+    throw std::runtime_error("Unknown metric " + name + " (euclidean, manhattan, chebyshev, cosine or mahalanobis)");
+}
+
+std::vector<point_max> Whiten(std::span<const point_max> points) {
+    constexpr int dim = point_max::dim;
+    if (points.empty()) {
+        return {};
+    }
+
+    std::array<double, dim> mean{};
+    for (const auto& p : points) {
+        for (int c = 0; c < dim; c++) mean[c] += p[c];
+    }
+    for (int c = 0; c < dim; c++) mean[c] /= points.size();
+
+    std::array<std::array<double, dim>, dim> covariance{};
+    for (const auto& p : points) {
+        for (int i = 0; i < dim; i++) {
+            for (int j = 0; j <= i; j++) {
+                covariance[i][j] += (p[i] - mean[i]) * (p[j] - mean[j]);
+            }
+        }
+    }
+
+    const double samples = std::max<double>(points.size() - 1, 1);
+    for (int i = 0; i < dim; i++) {
+        for (int j = 0; j <= i; j++) covariance[i][j] /= samples;
+    }
+
+    /*
+     * Cholesky decomposition covariance = L L^T, then L^-1 (p - mean) are the whitened points.
+     * Directions without (significant) variance get a zero pivot, and are left out of the whitened points.
+     * */
+    double trace = 0;
+    for (int c = 0; c < dim; c++) trace += covariance[c][c];
+    const double tolerance = 1e-10 * trace;
+
+    std::array<std::array<double, dim>, dim> L{};
+    for (int j = 0; j < dim; j++) {
+        double pivot = covariance[j][j];
+        for (int k = 0; k < j; k++) pivot -= L[j][k] * L[j][k];
+        if (pivot <= tolerance) {
+            continue;
+        }
+        L[j][j] = std::sqrt(pivot);
+        for (int i = j + 1; i < dim; i++) {
+            double value = covariance[i][j];
+            for (int k = 0; k < j; k++) value -= L[i][k] * L[j][k];
+            L[i][j] = value / L[j][j];
+        }
+    }
+
+    std::vector<point_max> result(points.size());
+    detail::parallel_for(0, points.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t p = begin; p < end; p++) {
+            // forward substitution L y = p - mean
+            std::array<double, dim> y{};
+            for (int i = 0; i < dim; i++) {
+                if (L[i][i] == 0) continue;
+                double value = points[p][i] - mean[i];
+                for (int k = 0; k < i; k++) value -= L[i][k] * y[k];
+                y[i] = value / L[i][i];
+            }
+            for (int c = 0; c < dim; c++) result[p][c] = (float)y[c];
+        }
+    }, 4096);
+    return result;
+}
+
+std::vector<float> FindDistanceMatrix(std::span<const point_max> points, Metric metric) {
+    if (metric == Metric::Mahalanobis) {
+        const auto whitened = Whiten(points);
+        return FindDistanceMatrix(whitened, Metric::Euclidean);
+    }
+
+    const size_t size = points.size();
+    std::vector<i32> indices(size);
+    std::iota(indices.begin(), indices.end(), 0);
+    const PointColumns columns{points, indices};
+
+    std::vector<float> result(size * size);
+    DispatchMetric(metric, [&](auto m) {
+        detail::parallel_for(0, size, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) {
+                float* row = result.data() + i * size;
+                columns.Distances<m.value>(points[i], row);
+                for (size_t j = 0; j < size; j++) {
+                    row[j] *= row[j];
+                }
+                row[i] = 0;
+            }
+        }, 16);
+    });
+    return result;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "point.h"
+#include "default.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Metrics between points, other than the euclidean distance that Compute uses by default.
+ * Every metric is a kernel that accumulates its distance coordinate by coordinate, so that the distances from one
+ * point to many others (stored per coordinate) compile to a single loop that vectorizes over the other points.
+ * The metric is picked once per job (DispatchMetric), never per pair of points.
+ * The Mahalanobis distance is the euclidean distance between whitened points, so it has no kernel of its own.
+ * */
+
+enum class Metric {
+    Euclidean,
+    Manhattan,
+    Chebyshev,
+    Cosine,
+    Mahalanobis,
+};
+
+// parse the name of a metric (euclidean, manhattan, chebyshev, cosine or mahalanobis)
+Metric ParseMetric(const std::string& name);
+
+// transform the points so that the euclidean distance between them is their Mahalanobis distance (with respect to
+// the covariance of the points), directions in which the points do not vary are ignored
+std::vector<point_max> Whiten(std::span<const point_max> points);
+
+// dense row-major matrix of the squared distances between all points, so in the units of Compute::Distance2
+// an edge of length d appears at epsilon = d / 2, like for the euclidean distance
+// for the Mahalanobis distance, this whitens the points first
+std::vector<float> FindDistanceMatrix(std::span<const point_max> points, Metric metric);
+
+
+template<Metric M>
+struct Kernel;
+
+template<>
+struct Kernel<Metric::Euclidean> {
+    float sum = 0;
+
+    void Add(float a, float b) {
+        const float dx = a - b;
+        sum += dx * dx;
+    }
+
+    float Distance() const {
+        return std::sqrt(sum);
+    }
+};
+
+template<>
+struct Kernel<Metric::Manhattan> {
+    float sum = 0;
+
+    void Add(float a, float b) {
+        sum += std::abs(a - b);
+    }
+
+    float Distance() const {
+        return sum;
+    }
+};
+
+template<>
+struct Kernel<Metric::Chebyshev> {
+    float max = 0;
+
+    void Add(float a, float b) {
+        max = std::max(max, std::abs(a - b));
+    }
+
+    float Distance() const {
+        return max;
+    }
+};
+
+// 1 - cos(angle) between the points as vectors, points at the origin are at distance 1 of everything
+template<>
+struct Kernel<Metric::Cosine> {
+    float dot = 0;
+    float norm_a = 0;
+    float norm_b = 0;
+
+    void Add(float a, float b) {
+        dot += a * b;
+        norm_a += a * a;
+        norm_b += b * b;
+    }
+
+    float Distance() const {
+        const float norms = norm_a * norm_b;
+        return norms > 0 ? std::max(0.0f, 1 - dot / std::sqrt(norms)) : 1.0f;
+    }
+};
+
+// call func with the metric as a compile time constant (std::integral_constant), Mahalanobis uses the euclidean kernel
+template<class F>
+decltype(auto) DispatchMetric(Metric metric, F&& func) {
+    switch (metric) {
+        case Metric::Manhattan: return func(std::integral_constant<Metric, Metric::Manhattan>{});
+        case Metric::Chebyshev: return func(std::integral_constant<Metric, Metric::Chebyshev>{});
+        case Metric::Cosine: return func(std::integral_constant<Metric, Metric::Cosine>{});
+        default: return func(std::integral_constant<Metric, Metric::Euclidean>{});
+    }
+}
+
+template<Metric M>
+float Distance(const point_max& a, const point_max& b) {
+    Kernel<M> kernel{};
+    for (int c = 0; c < point_max::dim; c++) {
+        kernel.Add(a[c], b[c]);
+    }
+    return kernel.Distance();
+}
+
+// points stored per coordinate (structure of arrays), so that computing the distances
+// from a single point to all of them vectorizes over the points
+struct PointColumns {
+    std::array<std::vector<float>, point_max::dim> coords;
+
+    PointColumns(std::span<const point_max> points, std::span<const i32> indices) {
+        for (int c = 0; c < point_max::dim; c++) {
+            coords[c].resize(indices.size());
+            for (size_t i = 0; i < indices.size(); i++) {
+                coords[c][i] = points[indices[i]][c];
+            }
+        }
+    }
+
+    size_t size() const {
+        return coords[0].size();
+    }
+
+    // distances from p to all points
+    template<Metric M>
+    void Distances(const point_max& p, float* __restrict dist) const {
+        const size_t count = size();
+        std::array<const float*, point_max::dim> columns;
+        for (int c = 0; c < point_max::dim; c++) {
+            columns[c] = coords[c].data();
+        }
+        for (size_t i = 0; i < count; i++) {
+            Kernel<M> kernel{};
+            for (int c = 0; c < point_max::dim; c++) {
+                kernel.Add(p[c], columns[c][i]);
+            }
+            dist[i] = kernel.Distance();
+        }
+    }
+};
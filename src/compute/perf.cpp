@@ -0,0 +1,117 @@
+#include "perf.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace perf {
+
+#ifdef __linux__
+
+namespace {
+
+// -1 for counters that could not be opened
+std::array<int, NumCounters> fds = {-1, -1, -1, -1, -1};
+bool enabled = false;
+
+int Open(u32 type, u64 config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // this process (and the threads it starts) on any cpu
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+}
+
+std::string Enable() {
+    if (enabled) {
+        return "";
+    }
+    constexpr u64 l1_read_miss = PERF_COUNT_HW_CACHE_L1D |
+                                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    fds[Cycles] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    if (fds[Cycles] < 0) {
+        // without cycles, the hardware counters are not there at all
+        if (errno == EACCES || errno == EPERM) {
+            return "perf events are not permitted (see /proc/sys/kernel/perf_event_paranoid)";
+        }
+        if (errno == ENOENT || errno == ENODEV || errno == EOPNOTSUPP) {
+            return "there are no hardware counters (this happens in most virtual machines)";
+        }
+        return std::string{"perf_event_open failed: "} + std::strerror(errno);
+    }
+    fds[Instructions] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[L1Misses] = Open(PERF_TYPE_HW_CACHE, l1_read_miss);
+    fds[LLCMisses] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[BranchMisses] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    enabled = true;
+    return "";
+}
+
+bool Enabled() {
+    return enabled;
+}
+
+Sample Read() {
+    Sample result{};
+    if (!enabled) {
+        return result;
+    }
+    for (int i = 0; i < NumCounters; i++) {
+        // value, time enabled, time running
+        u64 values[3];
+        if (fds[i] < 0 || read(fds[i], values, sizeof(values)) != sizeof(values)) {
+            continue;
+        }
+        result.values[i] = values[0];
+        result.enabled[i] = values[1];
+        result.running[i] = values[2];
+    }
+    return result;
+}
+
+#else
+
+std::string Enable() {
+    return "hardware counters are only supported on Linux";
+}
+
+bool Enabled() {
+    return false;
+}
+
+Sample Read() {
+    return {};
+}
+
+#endif
+
+values_t Difference(const Sample& start, const Sample& end) {
+    values_t result{};
+    for (int i = 0; i < NumCounters; i++) {
+        if (end.running[i] <= start.running[i] || end.values[i] < start.values[i]) {
+            // not counted in between (or a read failed)
+            continue;
+        }
+        // the raw values and times only ever increase
+        const u64 count = end.values[i] - start.values[i];
+        const u64 enabled = end.enabled[i] - start.enabled[i];
+        const u64 running = end.running[i] - start.running[i];
+        result[i] = running == enabled ? count : (u64)((double)count * enabled / running);
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "default.h"
+
+#include <array>
+#include <string>
+
+
+/*
+ * Hardware performance counters (perf_event_open, so only on Linux) for the stages of a computation. The counters are
+ * opened once for the whole process with inherit set, so the threads that are started later (the workers of
+ * parallel_for) are counted as well, and their counts are added to the stage that started them when they exit.
+ * Only user space is counted, which is what perf_event_paranoid allows by default. If the kernel does not allow
+ * perf events at all (or there is no PMU, like on some virtual machines), Enable fails with a reason and the stages
+ * are only timed. Counters that are multiplexed (there are more of them than hardware registers) are scaled up by
+ * the time they were actually counting.
+ * */
+
+namespace perf {
+
+enum Counter {
+    Cycles,
+    Instructions,
+    L1Misses,
+    LLCMisses,
+    BranchMisses,
+    NumCounters,
+};
+
+inline constexpr std::array<const char*, NumCounters> names = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+using values_t = std::array<u64, NumCounters>;
+
+// open the counters, returns an empty string if that worked, the reason why not otherwise
+std::string Enable();
+
+bool Enabled();
+
+// raw values of the counters since Enable, with the times they were enabled and running
+struct Sample {
+    values_t values{};
+    values_t enabled{};
+    values_t running{};
+};
+
+// current values of the counters, all 0 if they are not enabled
+Sample Read();
+
+// (scaled) counts between two samples
+// a multiplexed counter is scaled by the time it was counting between them, so the count is never negative
+values_t Difference(const Sample& start, const Sample& end);
+
+}
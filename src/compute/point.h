@@ -3,6 +3,7 @@
 #include "default.h"
 
 #include <array>
+#include <cstddef>
 
 
 template<typename T, size_t n>
@@ -0,0 +1,312 @@
+#include "predicates.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+// a number as a sum of non-overlapping doubles, in increasing magnitude (without zeros)
+using expansion_t = std::vector<double>;
+
+void TwoSum(double a, double b, double& x, double& y) {
+    x = a + b;
+    const double b_virtual = x - a;
+    const double a_virtual = x - b_virtual;
+    y = (a - a_virtual) + (b - b_virtual);
+}
+
+void TwoProduct(double a, double b, double& x, double& y) {
+    x = a * b;
+    y = std::fma(a, b, -x);
+}
+
+expansion_t Difference(double a, double b) {
+    double x, y;
+    TwoSum(a, -b, x, y);
+    expansion_t result{};
+    if (y != 0) result.push_back(y);
+    if (x != 0) result.push_back(x);
+    return result;
+}
+
+expansion_t Grow(const expansion_t& e, double b) {
+    expansion_t result{};
+    result.reserve(e.size() + 1);
+    double q = b;
+    for (double component : e) {
+        double h;
+        TwoSum(q, component, q, h);
+        if (h != 0) result.push_back(h);
+    }
+    if (q != 0) result.push_back(q);
+    return result;
+}
+
+expansion_t Sum(expansion_t e, const expansion_t& f) {
+    for (double component : f) {
+        e = Grow(e, component);
+    }
+    return e;
+}
+
+expansion_t Negate(expansion_t e) {
+    for (auto& component : e) component = -component;
+    return e;
+}
+
+expansion_t Scale(const expansion_t& e, double b) {
+    expansion_t result{};
+    if (e.empty() || b == 0) {
+        return result;
+    }
+    result.reserve(2 * e.size());
+
+    double q, h;
+    TwoProduct(e[0], b, q, h);
+    if (h != 0) result.push_back(h);
+    for (size_t i = 1; i < e.size(); i++) {
+        double product, product_error, sum;
+        TwoProduct(e[i], b, product, product_error);
+        TwoSum(q, product_error, sum, h);
+        if (h != 0) result.push_back(h);
+        TwoSum(product, sum, q, h);
+        if (h != 0) result.push_back(h);
+    }
+    if (q != 0) result.push_back(q);
+    return result;
+}
+
+expansion_t Product(const expansion_t& e, const expansion_t& f) {
+    expansion_t result{};
+    for (double component : f) {
+        result = Sum(std::move(result), Scale(e, component));
+    }
+    return result;
+}
+
+int Sign(const expansion_t& e) {
+    // the largest component determines the sign of a non-overlapping expansion
+    if (e.empty()) return 0;
+    return e.back() > 0 ? 1 : -1;
+}
+
+double Estimate(const expansion_t& e) {
+    double result = 0;
+    for (double component : e) result += component;
+    return result;
+}
+
+int Sign(double value) {
+    return (value > 0) - (value < 0);
+}
+
+/*
+ * Determinants of (at most 4 x 4) matrices by cofactor expansion along the rows, both in floating point with the
+ * permanent (the same expansion with absolute values) to bound the rounding error, and exactly for expansions.
+ * */
+template<int K>
+using matrix_t = std::array<std::array<double, K>, K>;
+
+template<int K>
+using exact_matrix_t = std::array<std::array<expansion_t, K>, K>;
+
+template<int K>
+void Determinant(const matrix_t<K>& m, int row, u32 columns, double& det, double& permanent) {
+    if (row == K - 1) {
+        for (int c = 0; c < K; c++) {
+            if (columns & (1u << c)) {
+                det = m[row][c];
+                permanent = std::abs(m[row][c]);
+                return;
+            }
+        }
+    }
+
+    det = 0;
+    permanent = 0;
+    int sign = 1;
+    for (int c = 0; c < K; c++) {
+        if (!(columns & (1u << c))) continue;
+        double minor, minor_permanent;
+        Determinant<K>(m, row + 1, columns & ~(1u << c), minor, minor_permanent);
+        det += sign * m[row][c] * minor;
+        permanent += std::abs(m[row][c]) * minor_permanent;
+        sign = -sign;
+    }
+}
+
+// (the exact determinant takes its size at runtime, since we also need it for the circumspheres of faces)
+template<class Matrix>
+expansion_t Determinant(const Matrix& m, int size, int row, u32 columns) {
+    if (row == size - 1) {
+        for (int c = 0; c < size; c++) {
+            if (columns & (1u << c)) return m[row][c];
+        }
+    }
+
+    expansion_t det{};
+    int sign = 1;
+    for (int c = 0; c < size; c++) {
+        if (!(columns & (1u << c))) continue;
+        auto term = Product(m[row][c], Determinant(m, size, row + 1, columns & ~(1u << c)));
+        det = Sum(std::move(det), sign > 0 ? term : Negate(std::move(term)));
+        sign = -sign;
+    }
+    return det;
+}
+
+/*
+ * The relative error of the floating point determinants is at most a small multiple of the machine epsilon
+ * times the permanent (Shewchuk derives bounds of about 10 epsilon for these sizes), we leave a wide margin.
+ * */
+constexpr double ErrorBound = 1e-12;
+
+template<int K>
+int SignOfDeterminant(const matrix_t<K>& m, auto&& exact) {
+    double det, permanent;
+    Determinant<K>(m, 0, (1u << K) - 1, det, permanent);
+    if (std::abs(det) > ErrorBound * permanent) {
+        return Sign(det);
+    }
+    return Sign(Determinant(exact(), K, 0, (1u << K) - 1));
+}
+
+}
+
+
+template<int D>
+int Predicates<D>::Orient(const std::array<const point_t*, D + 1>& p) {
+    const point_t& origin = *p[D];
+    matrix_t<D> m;
+    for (int i = 0; i < D; i++) {
+        for (int c = 0; c < D; c++) {
+            m[i][c] = (*p[i])[c] - origin[c];
+        }
+    }
+    return SignOfDeterminant<D>(m, [&]() {
+        exact_matrix_t<D> exact;
+        for (int i = 0; i < D; i++) {
+            for (int c = 0; c < D; c++) {
+                exact[i][c] = Difference((*p[i])[c], origin[c]);
+            }
+        }
+        return exact;
+    });
+}
+
+template<int D>
+int Predicates<D>::InSphere(const std::array<const point_t*, D + 2>& p) {
+    const point_t& origin = *p[D + 1];
+    matrix_t<D + 1> m;
+    for (int i = 0; i <= D; i++) {
+        m[i][D] = 0;
+        for (int c = 0; c < D; c++) {
+            m[i][c] = (*p[i])[c] - origin[c];
+            m[i][D] += m[i][c] * m[i][c];
+        }
+    }
+    return SignOfDeterminant<D + 1>(m, [&]() {
+        exact_matrix_t<D + 1> exact;
+        for (int i = 0; i <= D; i++) {
+            for (int c = 0; c < D; c++) {
+                exact[i][c] = Difference((*p[i])[c], origin[c]);
+                exact[i][D] = Sum(std::move(exact[i][D]), Product(exact[i][c], exact[i][c]));
+            }
+        }
+        return exact;
+    });
+}
+
+template<int D>
+int Predicates<D>::InSpherePerturbed(const std::array<const point_t*, D + 2>& p, const std::array<i32, D + 2>& indices) {
+    const int sign = InSphere(p);
+    if (sign != 0) {
+        return sign;
+    }
+
+    /*
+     * The lifted determinant equals det(p[i], |p[i]|^2, 1). Raising the lifted coordinate of point i by an
+     * infinitesimal adds that times its cofactor (-1)^(i + D) * det(p[j], 1) for j != i, which is the orientation
+     * of the other points. The most perturbed point with a non-zero cofactor decides the sign.
+     * */
+    std::array<int, D + 2> order;
+    for (int i = 0; i < D + 2; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return indices[a] > indices[b]; });
+
+    for (int i : order) {
+        std::array<const point_t*, D + 1> rest;
+        for (int j = 0, k = 0; j < D + 2; j++) {
+            if (j != i) rest[k++] = p[j];
+        }
+        const int orient = Orient(rest);
+        if (orient != 0) {
+            return ((i + D) % 2 == 0) ? orient : -orient;
+        }
+    }
+    return 0;
+}
+
+template<int D>
+double Predicates<D>::SmallestCircumsphere(const std::array<const point_t*, D + 1>& p, int k,
+                                           const std::vector<const point_t*>& others, bool& empty) {
+    /*
+     * With a[j] = p[j] - p[0], the center is p[0] + sum_j lambda_j a[j], where G lambda = b for the Gram matrix
+     * G = (a[i] . a[j]) and b = (|a[i]|^2 / 2). By Cramer's rule, the center is p[0] + u / det(G), with
+     * u = sum_j det(G_j) a[j] (G_j is G with column j replaced by b). So the squared radius is |u|^2 / det(G)^2,
+     * and q lies inside the sphere exactly when |det(G) (q - p[0]) - u|^2 < |u|^2.
+     * */
+    std::array<std::array<expansion_t, D>, D> a{};
+    for (int j = 0; j < k; j++) {
+        for (int c = 0; c < D; c++) {
+            a[j][c] = Difference((*p[j + 1])[c], (*p[0])[c]);
+        }
+    }
+    std::array<std::array<expansion_t, D>, D> gram{};
+    std::array<expansion_t, D> b{};
+    for (int i = 0; i < k; i++) {
+        for (int c = 0; c < D; c++) {
+            b[i] = Sum(std::move(b[i]), Scale(Product(a[i][c], a[i][c]), 0.5));
+            for (int j = 0; j < k; j++) {
+                gram[i][j] = Sum(std::move(gram[i][j]), Product(a[i][c], a[j][c]));
+            }
+        }
+    }
+
+    const u32 columns = (1u << k) - 1;
+    const expansion_t det = Determinant(gram, k, 0, columns);
+    std::array<expansion_t, D> u{};
+    for (int j = 0; j < k; j++) {
+        auto replaced = gram;
+        for (int i = 0; i < k; i++) {
+            replaced[i][j] = b[i];
+        }
+        const expansion_t weight = Determinant(replaced, k, 0, columns);
+        for (int c = 0; c < D; c++) {
+            u[c] = Sum(std::move(u[c]), Product(weight, a[j][c]));
+        }
+    }
+
+    expansion_t u2{};
+    for (int c = 0; c < D; c++) {
+        u2 = Sum(std::move(u2), Product(u[c], u[c]));
+    }
+
+    empty = true;
+    for (const point_t* q : others) {
+        expansion_t dist2{};
+        for (int c = 0; c < D; c++) {
+            auto t = Sum(Product(det, Difference((*q)[c], (*p[0])[c])), Negate(u[c]));
+            dist2 = Sum(std::move(dist2), Product(t, t));
+        }
+        if (Sign(Sum(std::move(dist2), Negate(u2))) < 0) {
+            empty = false;
+            break;
+        }
+    }
+    return Estimate(u2) / Estimate(Product(det, det));
+}
+
+
+template struct Predicates<2>;
+template struct Predicates<3>;
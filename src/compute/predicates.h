@@ -0,0 +1,36 @@
+#pragma once
+
+#include "default.h"
+
+#include <array>
+#include <vector>
+
+/*
+ * Robust geometric predicates for Delaunay triangulations in D dimensions.
+ * The sign of each determinant is first computed in floating point. Only if the result is too close to 0 to be
+ * trusted, it is recomputed exactly with floating point expansions (sums of non-overlapping doubles, as in
+ * Shewchuk, "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates").
+ * */
+
+template<int D>
+struct Predicates {
+    using point_t = std::array<double, D>;
+
+    // sign of det(p[i] - p[D]), positive if the simplex p[0], ..., p[D] is positively oriented
+    static int Orient(const std::array<const point_t*, D + 1>& p);
+
+    // sign of the lifted determinant det(p[i] - p[D + 1], |p[i] - p[D + 1]|^2)
+    // for a positively oriented simplex p[0], ..., p[D], this is positive if p[D + 1] lies strictly inside
+    // its circumsphere, negative if it lies strictly outside and 0 if it lies on it
+    static int InSphere(const std::array<const point_t*, D + 2>& p);
+
+    // InSphere, but points on the circumsphere are decided by a symbolic perturbation of the lifted coordinate
+    // of the points, where points with higher indices are perturbed more. This only returns 0 if all points
+    // lie in a lower dimensional subspace.
+    static int InSpherePerturbed(const std::array<const point_t*, D + 2>& p, const std::array<i32, D + 2>& indices);
+
+    // squared radius of the smallest sphere through the (affinely independent) points p[0], ..., p[k] for k <= D,
+    // which is exact up to the final rounding, empty is set to whether none of the others lies strictly inside it
+    static double SmallestCircumsphere(const std::array<const point_t*, D + 1>& p, int k,
+                                       const std::vector<const point_t*>& others, bool& empty);
+};
@@ -1,42 +1,432 @@
 #include "reader.h"
 
+#include "parallel.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
-#include <sstream>
+#include <string>
+#include <type_traits>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-Reader::Reader(const std::string& filename, std::string separator) : separator(std::move(separator)) {
-    file = std::ifstream(filename);
 
-    if (!file.good()) {
+// chunks are at least this many bytes, so that small files are read on a single thread
+static constexpr size_t MinChunkBytes = 1 << 20;
+
+static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/*
+ * Call f(line_begin, line_end) for every line that starts in [begin, end), (without the line break).
+ * Lines that start in the range are handled completely, even if they run past its end,
+ * so that every line is handled by exactly one chunk.
+ * */
+template<class Func>
+static void ForEachLine(const char* data, size_t size, size_t begin, size_t end, Func&& f) {
+    const char* const stop = data + size;
+    const char* line = data + begin;
+    if (begin > 0 && data[begin - 1] != '\n') {
+        line = static_cast<const char*>(std::memchr(line, '\n', stop - line));
+        if (!line) return;
+        line++;
+    }
+    while (line < data + end) {
+        auto line_end = static_cast<const char*>(std::memchr(line, '\n', stop - line));
+        if (!line_end) line_end = stop;
+        f(line, line_end);
+        line = line_end + 1;
+    }
+}
+
+static bool IsBlank(const char* begin, const char* end) {
+    return std::all_of(begin, end, IsSpace);
+}
+
+/*
+ * Skip the whitespace (and line breaks, if newlines is set) and separators before the next value in [p, end),
+ * and parse it. Returns false if there is no next value.
+ * */
+template<typename T>
+static bool NextValue(const char*& p, const char* end, const std::string& separator, bool newlines, T& value) {
+    while (p < end) {
+        if (IsSpace(*p) || *p == '+' || (newlines && *p == '\n')) p++;
+        else if (!separator.empty() && (size_t)(end - p) >= separator.size()
+                 && std::memcmp(p, separator.data(), separator.size()) == 0) p += separator.size();
+        else break;
+    }
+    if (p == end) {
+        return false;
+    }
+    const auto [next, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc{}) {
+        throw std::runtime_error("Bad value " + std::string(p, std::find(p, end, '\n')));
+    }
+    p = next;
+    return true;
+}
+
+// find the value of a key in the header of a .npy file, which is a python dict literal
+static std::string NpyValue(const std::string& header, const std::string& key) {
+    const size_t at = header.find("'" + key + "'");
+    if (at == std::string::npos) {
+        throw std::runtime_error("Bad .npy header, missing " + key);
+    }
+    size_t begin = header.find(':', at) + 1;
+    while (begin < header.size() && header[begin] == ' ') begin++;
+    const size_t end = header.find(header[begin] == '(' ? ')' : ',', begin);
+    return header.substr(begin, end == std::string::npos ? std::string::npos : end - begin + (header[begin] == '('));
+}
+
+Reader::Reader(const std::string& filename, std::string separator) : separator(std::move(separator)) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+            filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    LARGE_INTEGER file_size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size)) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        throw std::runtime_error("Failed to open file!");
+    }
+    mapped_size = file_size.QuadPart;
+    if (mapped_size > 0) {
+        // the view keeps the mapping (and the file) alive after the handles are closed
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            mapped = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    const int file = open(filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if (file < 0 || fstat(file, &file_stat) != 0) {
+        if (file >= 0) close(file);
         throw std::runtime_error("Failed to open file!");
     }
+    mapped_size = file_stat.st_size;
+    if (mapped_size > 0) {
+        void* view = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view != MAP_FAILED) {
+            mapped = static_cast<const char*>(view);
+            madvise(view, mapped_size, MADV_SEQUENTIAL);
+        }
+    }
+    close(file);
+#endif
+
+    if (mapped_size > 0 && !mapped) {
+        throw std::runtime_error("Failed to map file!");
+    }
+    data = mapped;
+    size = mapped_size;
+    compression = Decompressor::Detect(mapped, mapped_size);
+}
+
+Reader::~Reader() {
+    if (!mapped) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+#else
+    munmap(const_cast<char*>(mapped), mapped_size);
+#endif
+}
+
+void Reader::Decompress() {
+    if (compression == Decompressor::Format::None) {
+        return;
+    }
+    Decompressor decompressor{mapped, mapped_size, compression};
+    for (auto block = decompressor.Next(); !block.empty(); block = decompressor.Next()) {
+        decompressed.insert(decompressed.end(), block.begin(), block.end());
+    }
+    data = decompressed.data();
+    size = decompressed.size();
+    compression = Decompressor::Format::None;
+}
+
+static bool IsBinaryPoints(const char* data, size_t size) {
+    return (size >= 6 && std::memcmp(data, "\x93NUMPY", 6) == 0) || (size >= 4 && std::memcmp(data, "SPXF", 4) == 0);
+}
+
+std::span<const point_max> Reader::Read() {
+    if (compression != Decompressor::Format::None) {
+        return ReadCompressed();
+    }
+    if (size >= 6 && std::memcmp(data, "\x93NUMPY", 6) == 0) {
+        return ReadNpy();
+    }
+    if (size >= 4 && std::memcmp(data, "SPXF", 4) == 0) {
+        return ReadRaw();
+    }
+    return ReadCsv();
 }
 
-std::vector<point_max> Reader::Read() {
-    std::vector<point_max> data;
-    std::string line;
-    const auto seplen = separator.length();
-    std::vector<char> sep(seplen);
-    sep.resize(seplen);
-
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        point_max point{};
-        int c = 0;
-        while (ss && (c < point_max::dim)) {
-            float x;
-            ss >> x;
-            if (ss) {
-                ss.read(sep.data(), seplen);
-                sep.push_back(0);
-                if (separator != sep.data()) {
-                    throw std::runtime_error("Bad separator");
+std::span<const point_max> Reader::ReadNpy() {
+    // magic string, version, header length (2 bytes in version 1, 4 bytes after that) and the header itself
+    if (size < 10) {
+        throw std::runtime_error("Bad .npy file");
+    }
+    const u8 major = data[6];
+    size_t header_length;
+    size_t offset;
+    if (major == 1) {
+        u16 length;
+        std::memcpy(&length, data + 8, sizeof(length));
+        header_length = length;
+        offset = 10;
+    }
+    else {
+        u32 length;
+        if (size < 12) throw std::runtime_error("Bad .npy file");
+        std::memcpy(&length, data + 8, sizeof(length));
+        header_length = length;
+        offset = 12;
+    }
+    if (offset + header_length > size) {
+        throw std::runtime_error("Bad .npy file");
+    }
+    const std::string header{data + offset, header_length};
+    offset += header_length;
+
+    if (NpyValue(header, "fortran_order") != "False") {
+        throw std::runtime_error(".npy arrays must be in C order");
+    }
+
+    // shape is (points,) or (points, coordinates)
+    const std::string shape = NpyValue(header, "shape");
+    size_t count = 0;
+    size_t dim = 1;
+    if (std::sscanf(shape.c_str(), "(%zu, %zu)", &count, &dim) < 1) {
+        throw std::runtime_error("Bad .npy shape " + shape);
+    }
+
+    const std::string descr = NpyValue(header, "descr");
+    if (descr == "'<f4'") {
+        return ReadBinary<float>(offset, count, dim);
+    }
+    if (descr == "'<f8'") {
+        return ReadBinary<double>(offset, count, dim);
+    }
+    throw std::runtime_error(".npy arrays must be little endian float32 or float64, got " + descr);
+}
+
+std::span<const point_max> Reader::ReadRaw() {
+    if (size < 16) {
+        throw std::runtime_error("Bad raw point file");
+    }
+    u32 dim;
+    u64 count;
+    std::memcpy(&dim, data + 4, sizeof(dim));
+    std::memcpy(&count, data + 8, sizeof(count));
+    return ReadBinary<float>(16, count, dim);
+}
+
+template<typename T>
+std::span<const point_max> Reader::ReadBinary(size_t offset, size_t count, size_t dim) {
+    if (dim == 0 || (size - offset) / dim / sizeof(T) < count) {
+        throw std::runtime_error("Point file is smaller than its header says");
+    }
+
+    // the file has exactly the layout of our points, so we use them in place
+    const char* begin = data + offset;
+    if (std::is_same_v<T, float> && dim == point_max::dim && sizeof(point_max) == point_max::dim * sizeof(float)
+        && reinterpret_cast<std::uintptr_t>(begin) % alignof(point_max) == 0) {
+        return {reinterpret_cast<const point_max*>(begin), count};
+    }
+
+    points.assign(count, point_max{});
+    const size_t copied = std::min<size_t>(dim, point_max::dim);
+    detail::parallel_for(0, count, [&](size_t chunk_begin, size_t chunk_end, size_t) {
+        for (size_t i = chunk_begin; i < chunk_end; i++) {
+            for (size_t c = 0; c < copied; c++) {
+                T value;
+                std::memcpy(&value, begin + (i * dim + c) * sizeof(T), sizeof(T));
+                points[i][c] = value;
+            }
+        }
+    }, MinChunkBytes / (dim * sizeof(T)) + 1);
+    return points;
+}
+
+std::span<const point_max> Reader::ReadCompressed() {
+    Decompressor decompressor{mapped, mapped_size, compression};
+    std::vector<char> block = decompressor.Next();
+
+    // binary files need all of their data at once
+    if (IsBinaryPoints(block.data(), block.size())) {
+        decompressed = std::move(block);
+        for (block = decompressor.Next(); !block.empty(); block = decompressor.Next()) {
+            decompressed.insert(decompressed.end(), block.begin(), block.end());
+        }
+        data = decompressed.data();
+        size = decompressed.size();
+        compression = Decompressor::Format::None;
+        return Read();
+    }
+
+    /*
+     * csv is parsed while the next blocks are decompressed, every block up to its last line break
+     * the rest of the block is the start of a line that continues in the next one
+     * */
+    points.clear();
+    std::vector<char> rest{};
+    size_t line_number = 0;
+    for (; !block.empty(); block = decompressor.Next()) {
+        if (!rest.empty()) {
+            rest.insert(rest.end(), block.begin(), block.end());
+            std::swap(rest, block);
+        }
+        const auto last = std::find(block.rbegin(), block.rend(), '\n');
+        const size_t complete = block.rend() - last;
+        line_number += ParseCsv(block.data(), complete, line_number);
+        rest.assign(block.begin() + complete, block.end());
+    }
+    ParseCsv(rest.data(), rest.size(), line_number);
+    return points;
+}
+
+std::span<const point_max> Reader::ReadCsv() {
+    points.clear();
+    ParseCsv(data, size, 0);
+    return points;
+}
+
+size_t Reader::ParseCsv(const char* text, size_t length, size_t first_line) {
+    const size_t chunks = detail::num_chunks(length, MinChunkBytes);
+
+    // first count the (non-blank) lines in every chunk, so that we know where their points go
+    std::vector<size_t> lines(chunks + 1, 0);
+    std::vector<size_t> counts(chunks + 1, 0);
+    detail::parallel_for(0, length, [&](size_t begin, size_t end, size_t chunk) {
+        ForEachLine(text, length, begin, end, [&](const char* line, const char* line_end) {
+            lines[chunk + 1]++;
+            if (!IsBlank(line, line_end)) counts[chunk + 1]++;
+        });
+    }, MinChunkBytes);
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        lines[chunk + 1] += lines[chunk];
+        counts[chunk + 1] += counts[chunk];
+    }
+
+    /*
+     * Then parse every chunk into its own part of the result. Lines can have fewer coordinates than a point,
+     * the rest are 0, and coordinates past the dimension of a point are ignored.
+     * We cannot throw from the worker threads, so every chunk keeps the first line it failed on.
+     * */
+    const size_t first_point = points.size();
+    points.resize(first_point + counts[chunks]);
+    std::vector<size_t> errors(chunks, 0);
+    const size_t seplen = separator.length();
+    detail::parallel_for(0, length, [&](size_t begin, size_t end, size_t chunk) {
+        size_t line_number = first_line + lines[chunk];
+        point_max* point = points.data() + first_point + counts[chunk];
+        ForEachLine(text, length, begin, end, [&](const char* line, const char* line_end) {
+            line_number++;
+            if (errors[chunk] || IsBlank(line, line_end)) return;
+
+            const char* p = line;
+            for (int c = 0; c < point_max::dim; c++) {
+                while (p < line_end && (IsSpace(*p) || *p == '+')) p++;
+                if (p == line_end) {
+                    break;
                 }
+                const auto [next, ec] = std::from_chars(p, line_end, (*point)[c]);
+                if (ec != std::errc{}) {
+                    errors[chunk] = line_number;
+                    return;
+                }
+                p = next;
+                if (IsBlank(p, line_end) || c == point_max::dim - 1) {
+                    break;
+                }
+                if ((size_t)(line_end - p) < seplen || std::memcmp(p, separator.data(), seplen) != 0) {
+                    errors[chunk] = line_number;
+                    return;
+                }
+                p += seplen;
             }
-            point[c++] = x;
+            point++;
+        });
+    }, MinChunkBytes);
+
+    for (size_t line_number : errors) {
+        if (line_number) {
+            throw std::runtime_error("Bad value or separator on line " + std::to_string(line_number));
+        }
+    }
+    return lines[chunks];
+}
+
+std::vector<float> Reader::ReadDistanceMatrix() {
+    Decompress();
+    std::vector<float> lower{};
+    size_t count;
+    if (size >= 8 && std::memcmp(data, "SPXD", 4) == 0) {
+        u32 points;
+        std::memcpy(&points, data + 4, sizeof(points));
+        count = points;
+        lower.resize(count * (count - 1) / 2);
+        if ((size - 8) / sizeof(float) < lower.size()) {
+            throw std::runtime_error("Distance matrix file is smaller than its header says");
+        }
+        std::memcpy(lower.data(), data + 8, lower.size() * sizeof(float));
+    }
+    else {
+        const char* p = data;
+        float value;
+        while (NextValue(p, data + size, separator, true, value)) {
+            lower.push_back(value);
+        }
+
+        // there are n (n - 1) / 2 distances between n points
+        count = 1;
+        while (count * (count - 1) / 2 < lower.size()) count++;
+        if (count * (count - 1) / 2 != lower.size()) {
+            throw std::runtime_error(
+                    "Lower triangular distance matrix has " + std::to_string(lower.size()) + " values, which is not n (n - 1) / 2 for any n"
+            );
         }
+    }
 
-        data.push_back(point);
+    std::vector<float> result(count * count, 0);
+    for (size_t i = 1, k = 0; i < count; i++) {
+        for (size_t j = 0; j < i; j++, k++) {
+            result[i * count + j] = result[j * count + i] = lower[k];
+        }
     }
-    return std::move(data);
+    return result;
+}
+
+std::vector<Graph::Edge> Reader::ReadEdges() {
+    Decompress();
+    std::vector<Graph::Edge> result{};
+    size_t line_number = 0;
+    ForEachLine(data, size, 0, size, [&](const char* line, const char* line_end) {
+        line_number++;
+        if (IsBlank(line, line_end)) return;
+
+        Graph::Edge edge;
+        const char* p = line;
+        if (!NextValue(p, line_end, separator, false, edge.a) || !NextValue(p, line_end, separator, false, edge.b)
+            || !NextValue(p, line_end, separator, false, edge.distance)) {
+            throw std::runtime_error("Expected an edge (a,b,distance) on line " + std::to_string(line_number));
+        }
+        result.push_back(edge);
+    });
+    return result;
 }
@@ -1,18 +1,76 @@
 #pragma once
 
 #include "point.h"
+#include "graph.h"
+#include "decompress.h"
 
-#include <fstream>
+#include <span>
 #include <string>
 #include <vector>
 
+/*
+ * Reads points from a file, which is memory mapped. The format is detected from the start of the file:
+ *  - .npy files (NumPy arrays of shape (points, coordinates), little endian float32 or float64, C order)
+ *  - raw files: the 4 characters "SPXF", the number of coordinates (u32) and points (u64), followed by
+ *    the coordinates of all points as little endian float32 (so 16 bytes of header, then point after point)
+ *  - otherwise csv, one point per line. The file is split into line aligned chunks that are parsed in parallel.
+ * Binary files with exactly MAX_POINT_DIM float32 coordinates per point are used in place, without copying them.
+ * Otherwise, missing coordinates are 0 and coordinates past MAX_POINT_DIM are ignored.
+ *
+ * Instead of points, a file can also hold distances between them:
+ *  - a dense lower triangular distance matrix (without the diagonal), so the distances from point 1 to point 0,
+ *    from point 2 to points 0 and 1, etc. This is either text (separated by the separator, spaces or line breaks),
+ *    or binary: the 4 characters "SPXD" and the number of points (u32), followed by the distances as little
+ *    endian float32
+ *  - a sparse edge list, with one "a,b,distance" edge per line (a and b are point indices, starting at 0)
+ *
+ * All of these can be gzip or zstd compressed. Compressed csv points are parsed block by block, while a background
+ * thread decompresses the next blocks. Other compressed files are decompressed completely before they are read.
+ * */
 
 struct Reader {
     Reader(const std::string& filename, std::string separator = ",");
+    ~Reader();
 
-    std::vector<point_max> Read();
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // the points are valid for as long as the reader is
+    std::span<const point_max> Read();
+
+    // the full (symmetric, row-major) matrix of distances between the points, in the given dense lower triangular matrix
+    std::vector<float> ReadDistanceMatrix();
+
+    std::vector<Graph::Edge> ReadEdges();
 
 private:
-    std::ifstream file;
     std::string separator;
-};
\ No newline at end of file
+
+    // the mapped file
+    const char* mapped = nullptr;
+    size_t mapped_size = 0;
+    Decompressor::Format compression = Decompressor::Format::None;
+
+    // the contents of the file, which are the mapped file itself, or the decompressed file
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<char> decompressed{};
+
+    // the points, if they could not be used from the mapped file directly
+    std::vector<point_max> points{};
+
+    // decompress the whole file, if it is compressed
+    void Decompress();
+
+    std::span<const point_max> ReadCompressed();
+    std::span<const point_max> ReadCsv();
+
+    // parse csv points in the given text and add them to points, returns the number of lines
+    // first_line is the number of lines before the text, for errors
+    size_t ParseCsv(const char* text, size_t length, size_t first_line);
+    std::span<const point_max> ReadNpy();
+    std::span<const point_max> ReadRaw();
+
+    template<typename T>
+    std::span<const point_max> ReadBinary(size_t offset, size_t count, size_t dim);
+};
@@ -0,0 +1,125 @@
+#include "scheduler.h"
+
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <string>
+
+
+Scheduler::Scheduler(ComputeBase& compute, int channels) : compute(compute), channels(channels) {
+    for (int channel = 0; channel < channels; channel++) {
+        workers.emplace_back([this, channel](std::stop_token stop) { Work(stop, channel); });
+    }
+}
+
+Scheduler::~Scheduler() {
+    std::lock_guard lock{mutex};
+    for (auto& channel : channels) {
+        channel.waiting.reset();
+        channel.stop.request_stop();
+    }
+}
+
+void Scheduler::Schedule(int channel, std::function<std::function<void()>()> run) {
+    {
+        std::lock_guard lock{mutex};
+        auto& state = channels.at(channel);
+        state.generation++;
+        state.waiting = Request{state.generation, std::move(run)};
+        if (state.running) {
+            state.stop.request_stop();
+        }
+    }
+    wake.notify_all();
+}
+
+void Scheduler::Drop(int channel) {
+    std::lock_guard lock{mutex};
+    auto& state = channels.at(channel);
+    state.generation++;
+    state.waiting.reset();
+    if (state.running) {
+        state.stop.request_stop();
+    }
+}
+
+void Scheduler::Cancel() {
+    std::lock_guard lock{mutex};
+    for (auto& channel : channels) {
+        if (channel.waiting) {
+            channel.generation++;
+            channel.waiting.reset();
+        }
+        channel.stop.request_stop();
+    }
+}
+
+bool Scheduler::Busy(int channel) const {
+    std::lock_guard lock{mutex};
+    const auto& state = channels.at(channel);
+    if (state.waiting || state.running) {
+        return true;
+    }
+    return std::any_of(deliveries.begin(), deliveries.end(), [&](const Delivery& delivery) {
+        return delivery.channel == channel && delivery.generation == state.generation;
+    });
+}
+
+bool Scheduler::Busy() const {
+    for (int channel = 0; channel < channels.size(); channel++) {
+        if (Busy(channel)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::Poll() {
+    std::vector<Delivery> done{};
+    {
+        std::lock_guard lock{mutex};
+        std::swap(done, deliveries);
+        // results for which a newer request was made in the meantime are dropped
+        std::erase_if(done, [&](const Delivery& delivery) {
+            return delivery.generation != channels[delivery.channel].generation;
+        });
+    }
+    // outside of the lock, delivering may submit new requests
+    for (auto& delivery : done) {
+        delivery.deliver();
+    }
+}
+
+void Scheduler::Work(std::stop_token stop, int channel) {
+    // the requests of different channels overlap, so every worker has its own block of lanes in a trace (after the
+    // ones of the main thread), which the workers of its parallel_for continue
+    trace::lane = (channel + 1) * detail::num_threads();
+    trace::NameLane(trace::lane, "scheduler " + std::to_string(channel));
+
+    auto& state = channels[channel];
+    std::unique_lock lock{mutex};
+    while (true) {
+        if (!wake.wait(lock, stop, [&] { return state.waiting.has_value(); })) {
+            // the scheduler is destroyed
+            return;
+        }
+
+        Request request = std::move(*state.waiting);
+        state.waiting.reset();
+        state.running = true;
+        state.stop = {};
+        // the token of the computation on this thread
+        ComputeBase::stop_token = state.stop.get_token();
+        compute.progress.Start(Progress::Phase::Idle, 0);
+
+        lock.unlock();
+        auto deliver = request.run();
+        lock.lock();
+
+        state.running = false;
+        if (request.generation == state.generation) {
+            deliveries.push_back({channel, request.generation, std::move(deliver)});
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "compute.h"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/*
+ * Runs the computations of the frontend on persistent worker threads, one for every channel (like the simplices that
+ * are drawn, or the homology basis), where the latest request wins. A new request replaces the one that is still
+ * waiting in its channel, and cancels the one of its channel that is running, so that moving a slider fast only
+ * computes where it is (whenever the worker is free), not every value it passed.
+ * Requests of different channels run concurrently, so they have to be queries that may run at the same time (see
+ * ComputeBase). Results are delivered on the thread that calls Poll (the render loop, which never waits for a worker),
+ * and only if no newer request was made on their channel since.
+ * */
+
+struct Scheduler {
+    Scheduler(ComputeBase& compute, int channels);
+
+    // cancels the running requests, and waits for the workers to stop
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // run func() on the worker, and then done(result) on the thread that calls Poll, where result is a (ready)
+    // std::future with what func returned or threw (like BudgetExceeded, or Cancelled if Cancel was called)
+    template<class F, class D>
+    void Submit(int channel, F func, D done);
+
+    // forget the request of a channel, nothing is delivered for it
+    void Drop(int channel);
+
+    // cancel all requests, only the ones that were running deliver (Cancelled)
+    void Cancel();
+
+    // whether a request of the channel is waiting, running or not delivered yet
+    bool Busy(int channel) const;
+
+    bool Busy() const;
+
+    // deliver the results that are done (on the calling thread)
+    void Poll();
+
+private:
+    struct Request {
+        u64 generation;
+        // computes on the worker, and returns the function that delivers the result
+        std::function<std::function<void()>()> run;
+    };
+
+    struct Channel {
+        // increased for every request (or drop), results of older generations are not delivered
+        u64 generation = 0;
+        std::optional<Request> waiting{};
+        bool running = false;
+        // stops the running request
+        std::stop_source stop{};
+    };
+
+    struct Delivery {
+        int channel;
+        u64 generation;
+        std::function<void()> deliver;
+    };
+
+    ComputeBase& compute;
+
+    mutable std::mutex mutex{};
+    std::condition_variable_any wake{};
+    std::vector<Channel> channels;
+    std::vector<Delivery> deliveries{};
+
+    void Schedule(int channel, std::function<std::function<void()>()> run);
+
+    void Work(std::stop_token stop, int channel);
+
+    // declared last, so that they are stopped (and joined) before the rest is destroyed
+    std::vector<std::jthread> workers{};
+};
+
+
+template<class F, class D>
+void Scheduler::Submit(int channel, F func, D done) {
+    using T = std::invoke_result_t<F>;
+    Schedule(channel, [func = std::move(func), done = std::move(done)]() mutable -> std::function<void()> {
+        std::promise<T> promise{};
+        try {
+            if constexpr(std::is_void_v<T>) {
+                func();
+                promise.set_value();
+            }
+            else {
+                promise.set_value(func());
+            }
+        }
+        catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+        // std::function has to be copyable, a future is not
+        auto result = std::make_shared<std::future<T>>(promise.get_future());
+        return [done, result] {
+            done(std::move(*result));
+        };
+    });
+}
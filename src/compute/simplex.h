@@ -114,7 +114,8 @@ struct Simplex {
         return false;
     }
 
-    operator bool() const {
+    // explicit, otherwise std::pair<float, Simplex> compares simplices as booleans in C++20 (through operator<=>)
+    explicit operator bool() const {
         return std::any_of(points.begin(), points.end(), [](const u64& v) { return v != 0; });
     }
 
@@ -135,6 +136,19 @@ struct Simplex {
         return result;
     }
 
+    Simplex& operator&=(const Simplex<N>& other) {
+        for (int i = 0; i < points.size(); i++) {
+            points[i] &= other.points[i];
+        }
+        return *this;
+    }
+
+    Simplex operator&(const Simplex<N>& other) const {
+        Simplex result = *this;
+        result &= other;
+        return result;
+    }
+
     Simplex& operator^=(const Simplex<N>& other) {
         for (int i = 0; i < points.size(); i++) {
             points[i] ^= other.points[i];
@@ -149,7 +163,7 @@ struct Simplex {
     }
 
     int Count() const {
-        return std::accumulate(points.begin(), points.end(), 0, std::popcount<u64>);
+        return std::accumulate(points.begin(), points.end(), 0, [](int count, u64 section) { return count + std::popcount(section); });
     }
 
     int FindLow() const {
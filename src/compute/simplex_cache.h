@@ -0,0 +1,184 @@
+#pragma once
+
+#include "simplex.h"
+#include "column.h"
+#include "default.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <boost/container/small_vector.hpp>
+
+
+/*
+ * All simplices of one dimension that have been found so far, with their filtration values.
+ * Simplices are only ever appended (FindnSimplices generates every simplex exactly once, since cofaces only get
+ * vertices with a higher index). Every search for a larger epsilon publishes a new snapshot, which holds the
+ * simplices it found (in plain arrays, in the order they were found) and owns the snapshot before it. A snapshot
+ * never changes once it is published, so queries can read the latest one without any locks while the next one is
+ * searched for, and keep using it as long as the cache exists. Only one thread may publish at a time (see
+ * Compute::FindnSimplices), and Reset may only be called while no other thread uses the cache.
+ * Looking up the value of a simplex goes through an open addressing hash table of indices into the snapshot, which
+ * is built on its first lookup. Flag complexes find the values of their simplices from their edges instead
+ * (Compute::ValueOf), so this is only needed for given filtrations, of which all simplices are in one snapshot.
+ * */
+
+template<size_t N>
+struct SimplexCache {
+    using simplex_t = Simplex<N>;
+
+    struct Snapshot {
+        // all simplices with a value up to max_epsilon are in this snapshot or the previous ones
+        float max_epsilon = {};
+        // the simplices that were found for this snapshot
+        std::vector<simplex_t> simplices{};
+        // filtration values, for the Vietoris Rips complex these are the (squared) diameters of the simplices
+        std::vector<filtration_t> diameters{};
+        std::unique_ptr<Snapshot> previous{};
+
+        void Add(const simplex_t& s, filtration_t diameter) {
+            simplices.push_back(s);
+            diameters.push_back(diameter);
+        }
+
+        // amount of simplices in this and the previous snapshots
+        size_t size() const {
+            return total;
+        }
+
+        // call func(simplex, value) for all simplices, in the order they were found
+        template<class F>
+        void ForEach(F&& func) const {
+            for (const Snapshot* part : Parts()) {
+                for (size_t k = 0; k < part->simplices.size(); k++) {
+                    func(part->simplices[k], part->diameters[k]);
+                }
+            }
+        }
+
+        // filtration value of a simplex that is in the snapshot
+        filtration_t At(const simplex_t& s) const {
+            std::call_once(indexed, [this] { BuildIndex(); });
+            for (size_t slot = Slot(s);; slot = (slot + 1) & (index.size() - 1)) {
+                const u32 i = index[slot];
+                if (i == 0) [[unlikely]] {
+                    throw std::out_of_range("Simplex is not in the cache");
+                }
+                const auto [part, k] = Find(i - 1);
+                if (part->simplices[k] == s) {
+                    return part->diameters[k];
+                }
+            }
+        }
+
+    private:
+        friend SimplexCache;
+
+        size_t total = 0;
+
+        // index + 1 of the simplex in every slot, 0 for an empty slot
+        mutable std::once_flag indexed{};
+        mutable std::vector<u32> index{};
+        // snapshots in the index (oldest first), with the index of their first simplex
+        mutable std::vector<const Snapshot*> parts{};
+        mutable std::vector<size_t> starts{};
+
+        // this and the previous snapshots, oldest first
+        boost::container::small_vector<const Snapshot*, 16> Parts() const {
+            boost::container::small_vector<const Snapshot*, 16> result{};
+            for (const Snapshot* part = this; part; part = part->previous.get()) {
+                result.push_back(part);
+            }
+            std::reverse(result.begin(), result.end());
+            return result;
+        }
+
+        // snapshot and position in it of the simplex with the given index
+        std::pair<const Snapshot*, size_t> Find(size_t i) const {
+            if (parts.size() == 1) [[likely]] {
+                return {parts[0], i};
+            }
+            const size_t part = std::upper_bound(starts.begin(), starts.end(), i) - starts.begin() - 1;
+            return {parts[part], i - starts[part]};
+        }
+
+        size_t Slot(const simplex_t& s) const {
+            // hash_value is not very well spread out, so we mix it before taking the high bits
+            const u64 hash = u64(hash_value(s)) * 0x9e3779b97f4a7c15ull;
+            return hash >> (64 - std::countr_zero(index.size()));
+        }
+
+        void BuildIndex() const {
+            size_t start = 0;
+            for (const Snapshot* part : Parts()) {
+                parts.push_back(part);
+                starts.push_back(start);
+                start += part->simplices.size();
+            }
+
+            // at most half of the slots are used
+            index.assign(std::max<size_t>(std::bit_ceil(2 * total), 2), 0);
+            size_t i = 0;
+            ForEach([&](const simplex_t& s, filtration_t) {
+                size_t slot = Slot(s);
+                while (index[slot] != 0) {
+                    slot = (slot + 1) & (index.size() - 1);
+                }
+                index[slot] = ++i;
+            });
+        }
+    };
+
+    SimplexCache() : head(std::make_unique<Snapshot>()), latest(head.get()) {
+
+    }
+
+    ~SimplexCache() {
+        Release();
+    }
+
+    SimplexCache(const SimplexCache&) = delete;
+    SimplexCache& operator=(const SimplexCache&) = delete;
+
+    // the latest snapshot, it stays valid (and unchanged) until the cache is reset
+    const Snapshot& Load() const {
+        return *latest.load(std::memory_order_acquire);
+    }
+
+    // publish the simplices that were found up to max_epsilon, after the ones that were already there
+    void Publish(std::unique_ptr<Snapshot> snapshot, float max_epsilon) {
+        snapshot->max_epsilon = max_epsilon;
+        snapshot->total = head->total + snapshot->simplices.size();
+        snapshot->previous = std::move(head);
+        head = std::move(snapshot);
+        latest.store(head.get(), std::memory_order_release);
+    }
+
+    // replace all simplices by the given ones, found up to max_epsilon
+    void Reset(std::unique_ptr<Snapshot> snapshot, float max_epsilon) {
+        Release();
+        snapshot->max_epsilon = max_epsilon;
+        snapshot->total = snapshot->simplices.size();
+        head = std::move(snapshot);
+        latest.store(head.get(), std::memory_order_release);
+    }
+
+    void Clear() {
+        Reset(std::make_unique<Snapshot>(), 0);
+    }
+
+private:
+    std::unique_ptr<Snapshot> head;
+    std::atomic<const Snapshot*> latest;
+
+    // destroy the snapshots one by one, destroying the latest one would recurse through all of them
+    void Release() {
+        while (head) {
+            head = std::move(head->previous);
+        }
+    }
+};
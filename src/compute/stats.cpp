@@ -0,0 +1,77 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <mutex>
+
+
+namespace {
+
+// queries that run concurrently add their stages to the same stats, stages are few enough to share one lock
+std::mutex stages_mutex{};
+
+}
+
+Stats::Stage& Stats::FindStage(const std::string& name) {
+    auto stage = std::find_if(stages.begin(), stages.end(), [&](const Stage& s) { return s.name == name; });
+    if (stage == stages.end()) {
+        stages.push_back({name});
+        return stages.back();
+    }
+    return *stage;
+}
+
+void Stats::AddStage(const std::string& name, double seconds, const perf::values_t& counters) {
+    std::lock_guard lock{stages_mutex};
+    auto& stage = FindStage(name);
+    stage.seconds += seconds;
+    stage.calls++;
+    for (int i = 0; i < perf::NumCounters; i++) {
+        stage.counters[i] += counters[i];
+    }
+}
+
+void Stats::Merge(const Stats& other) {
+    for (const auto& stage : other.stages) {
+        auto& merged = FindStage(stage.name);
+        merged.seconds += stage.seconds;
+        merged.calls += stage.calls;
+        for (int i = 0; i < perf::NumCounters; i++) {
+            merged.counters[i] += stage.counters[i];
+        }
+    }
+    for (int n = 0; n < simplices.size(); n++) {
+        simplices[n] += other.simplices[n];
+    }
+    boundaries += other.boundaries;
+    column_additions += other.column_additions;
+    hash_probes += other.hash_probes;
+    peak_column_length = std::max(peak_column_length, other.peak_column_length);
+    bytes_allocated += other.bytes_allocated;
+}
+
+void Stats::WriteJson(std::ostream& os) const {
+    // stage names are our own, so they never need escaping
+    os << "{\n  \"stages\": [";
+    for (size_t i = 0; i < stages.size(); i++) {
+        os << (i ? ",\n" : "\n") << "    {\"name\": \"" << stages[i].name << "\", \"seconds\": " << stages[i].seconds
+           << ", \"calls\": " << stages[i].calls;
+        if (perf::Enabled()) {
+            for (int c = 0; c < perf::NumCounters; c++) {
+                os << ", \"" << perf::names[c] << "\": " << stages[i].counters[c];
+            }
+        }
+        os << "}";
+    }
+    os << (stages.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"simplices\": [";
+    for (size_t n = 0; n < simplices.size(); n++) {
+        os << (n ? ", " : "") << simplices[n];
+    }
+    os << "],\n";
+    os << "  \"boundaries\": " << boundaries << ",\n";
+    os << "  \"column_additions\": " << column_additions << ",\n";
+    os << "  \"hash_probes\": " << hash_probes << ",\n";
+    os << "  \"peak_column_length\": " << peak_column_length << ",\n";
+    os << "  \"bytes_allocated\": " << bytes_allocated << "\n";
+    os << "}" << std::endl;
+}
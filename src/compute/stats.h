@@ -0,0 +1,92 @@
+#pragma once
+
+#include "default.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+/*
+ * Where a computation spent its time, and some counters of the work it did. Stages are timed as a whole (a stage that
+ * runs more than once accumulates its time and calls), stages may run within other stages (for example the ordering
+ * of the simplices is part of a reduction). The counters are plain increments in the hot loops, they are always kept
+ * since they cost next to nothing compared to the hash map lookups and column additions they count.
+ * If the hardware counters are enabled (see perf.h), every stage also gets their counts.
+ * */
+
+struct Stats {
+    struct Stage {
+        std::string name;
+        double seconds = 0;
+        u64 calls = 0;
+        // hardware counters (all 0 if they are not enabled)
+        perf::values_t counters{};
+    };
+
+    // in the order in which they first ran
+    std::vector<Stage> stages{};
+
+    // amount of simplices per dimension that were found
+    std::array<u64, MAX_HOMOLOGY_DIM + 1> simplices{};
+
+    // boundaries that were constructed (BoundaryOf)
+    u64 boundaries = 0;
+
+    // columns that were added to other columns in reductions
+    u64 column_additions = 0;
+
+    // lookups, insertions and removals in hash maps (the B / Z matrices, the Morse matching and the simplex cache)
+    u64 hash_probes = 0;
+
+    // most entries that a column had after an addition
+    u64 peak_column_length = 0;
+
+    // bytes that were allocated for columns and bases in reductions
+    u64 bytes_allocated = 0;
+
+    // safe to call from concurrent queries (the counters below are only counted by one reduction at a time)
+    void AddStage(const std::string& name, double seconds, const perf::values_t& counters = {});
+
+    void Clear() {
+        *this = {};
+    }
+
+    // add the stages and counters of another computation to these
+    void Merge(const Stats& other);
+
+    void WriteJson(std::ostream& os) const;
+
+private:
+    // stage with the given name, added if it did not run before
+    Stage& FindStage(const std::string& name);
+};
+
+
+// adds the wall time between its construction and destruction to a stage
+struct StageTimer {
+    StageTimer(Stats& stats, std::string stage) :
+            stats(stats), stage(std::move(stage)), span(this->stage),
+            start(std::chrono::steady_clock::now()), start_counters(perf::Read()) {
+
+    }
+
+    ~StageTimer() {
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        stats.AddStage(stage, duration.count(), perf::Difference(start_counters, perf::Read()));
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    Stats& stats;
+    std::string stage;
+    // the stage is also a span in the trace (if it is enabled)
+    trace::Span span;
+    std::chrono::steady_clock::time_point start;
+    perf::Sample start_counters;
+};
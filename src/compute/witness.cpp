@@ -0,0 +1,173 @@
+#include "witness.h"
+
+#include "parallel.h"
+#include "metric.h"
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <cmath>
+#include <limits>
+#include <random>
+
+
+std::vector<i32> Witness::SelectLandmarks(size_t count, Landmarks method, u32 seed) const {
+    count = std::min(count, points.size());
+    if (count == 0) {
+        return {};
+    }
+
+    switch (method) {
+        case Landmarks::MaxMin:
+            return DispatchMetric(metric, [&](auto m) { return SelectMaxMin<m.value>(count, seed); });
+        case Landmarks::Random: return SelectRandom(count, seed);
+    }
+    return {};
+}
+
+std::vector<i32> Witness::SelectRandom(size_t count, u32 seed) const {
+    std::vector<i32> landmarks{};
+    landmarks.reserve(count);
+    std::mt19937 gen{seed};
+
+    // selection sampling: take every point with probability (still needed) / (points left)
+    for (size_t i = 0; i < points.size() && landmarks.size() < count; i++) {
+        const size_t left = points.size() - i;
+        if (std::uniform_int_distribution<size_t>{0, left - 1}(gen) < count - landmarks.size()) {
+            landmarks.push_back((i32)i);
+        }
+    }
+    return landmarks;
+}
+
+template<Metric M>
+std::vector<i32> Witness::SelectMaxMin(size_t count, u32 seed) const {
+    std::vector<i32> landmarks{};
+    landmarks.reserve(count);
+    std::mt19937 gen{seed};
+    landmarks.push_back(std::uniform_int_distribution<i32>{0, (i32)points.size() - 1}(gen));
+
+    // distance from every point to its closest landmark so far
+    std::vector<float> min_dist(points.size(), std::numeric_limits<float>::infinity());
+
+    // every chunk keeps track of its farthest point, the completion step of the barrier then
+    // picks the farthest point overall as the next landmark (while all threads are waiting)
+    constexpr size_t min_chunk = 4096;
+    const size_t chunks = detail::num_chunks(points.size(), min_chunk);
+    std::vector<std::pair<float, i32>> farthest(chunks);
+    std::barrier sync(chunks, [&]() noexcept {
+        const auto [dist, index] = *std::max_element(farthest.begin(), farthest.end());
+        if (dist > 0) {
+            landmarks.push_back(index);
+        }
+        else {
+            // all remaining points coincide with a landmark
+            count = landmarks.size();
+        }
+    });
+
+    detail::parallel_for(0, points.size(), [&](size_t begin, size_t end, size_t chunk) {
+        while (landmarks.size() < count) {
+            const point_t& landmark = points[landmarks.back()];
+            std::pair<float, i32> chunk_farthest{-1, -1};
+            for (size_t i = begin; i < end; i++) {
+                min_dist[i] = std::min(min_dist[i], Distance<M>(points[i], landmark));
+                if (min_dist[i] > chunk_farthest.first) {
+                    chunk_farthest = {min_dist[i], (i32)i};
+                }
+            }
+            farthest[chunk] = chunk_farthest;
+            sync.arrive_and_wait();
+        }
+    }, min_chunk);
+    return landmarks;
+}
+
+std::vector<float> Witness::FindLazyWitnessDistances(const std::vector<i32>& landmarks, int nu, float max_epsilon) const {
+    return DispatchMetric(metric, [&](auto m) { return FindLazyWitnessDistancesImpl<m.value>(landmarks, nu, max_epsilon); });
+}
+
+template<Metric M>
+std::vector<float> Witness::FindLazyWitnessDistancesImpl(const std::vector<i32>& landmarks, int nu, float max_epsilon) const {
+    const size_t size = landmarks.size();
+    if (size == 0) {
+        return {};
+    }
+    nu = std::clamp(nu, 0, (int)size);
+    const PointColumns coords{points, landmarks};
+
+    // edges are compared against 4 * epsilon * epsilon, so the radius in the witness condition is 2 * epsilon
+    const float max_radius = 2 * max_epsilon;
+
+    // every thread keeps its own (upper triangular) matrix of minimal values, these are merged afterwards
+    constexpr size_t min_chunk = 1024;
+    const size_t chunks = detail::num_chunks(points.size(), min_chunk);
+    std::vector<std::vector<float>> local(chunks);
+
+    detail::parallel_for(0, points.size(), [&](size_t begin, size_t end, size_t chunk) {
+        auto& values = local[chunk];
+        values.assign(size * size, std::numeric_limits<float>::infinity());
+
+        std::vector<float> dist(size);
+        std::vector<float> scratch(size);
+        std::vector<std::pair<float, i32>> close{};
+        close.reserve(size);
+
+        for (size_t w = begin; w < end; w++) {
+            coords.Distances<M>(points[w], dist.data());
+
+            // distance to the nu-th closest landmark
+            float m = 0;
+            if (nu > 0) {
+                scratch = dist;
+                std::nth_element(scratch.begin(), scratch.begin() + (nu - 1), scratch.end());
+                m = scratch[nu - 1];
+            }
+
+            // only landmarks within max_radius + m can form an edge that we are interested in
+            close.clear();
+            for (size_t l = 0; l < size; l++) {
+                if (dist[l] <= max_radius + m) {
+                    close.emplace_back(dist[l], (i32)l);
+                }
+            }
+            std::sort(close.begin(), close.end());
+
+            // for sorted landmarks, max(d(w, a), d(w, b)) is just the distance to the farthest one
+            for (size_t j = 1; j < close.size(); j++) {
+                const float radius = std::max(close[j].first - m, 0.0f);
+                const float value = radius * radius;
+                for (size_t i = 0; i < j; i++) {
+                    const auto [a, b] = std::minmax(close[i].second, close[j].second);
+                    float& current = values[a * size + b];
+                    current = std::min(current, value);
+                }
+            }
+        }
+    }, min_chunk);
+
+    std::vector<float> result(size * size, std::numeric_limits<float>::infinity());
+    detail::parallel_for(0, size, [&](size_t begin, size_t end, size_t) {
+        for (size_t a = begin; a < end; a++) {
+            result[a * size + a] = 0;
+            for (size_t b = a + 1; b < size; b++) {
+                float value = std::numeric_limits<float>::infinity();
+                for (const auto& values : local) {
+                    value = std::min(value, values[a * size + b]);
+                }
+                if (value > max_radius * max_radius) {
+                    value = std::numeric_limits<float>::infinity();
+                }
+                result[a * size + b] = value;
+            }
+        }
+    });
+
+    // the matrix is symmetric
+    for (size_t a = 0; a < size; a++) {
+        for (size_t b = a + 1; b < size; b++) {
+            result[b * size + a] = result[a * size + b];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "point.h"
+#include "metric.h"
+#include "default.h"
+
+#include <span>
+#include <vector>
+
+/*
+ * For large point clouds, we cannot build a complex on all points (simplices are bitsets of at most N points).
+ * Instead, we select a small set of landmarks and build the lazy witness complex on them, using all points as
+ * witnesses:
+ *  - a landmark edge (a, b) exists at radius R if there is a witness w with max(d(w, a), d(w, b)) - m(w) <= R,
+ *    where m(w) is the distance from w to its nu-th closest landmark (m(w) = 0 for nu = 0)
+ *  - higher dimensional simplices exist whenever all their edges do (just like in the Vietoris Rips complex)
+ * The result is a matrix of (squared) edge values, which the regular reduction can use in place of Distance2.
+ * Distances between witnesses and landmarks can be in any metric, for the Mahalanobis distance the points must be
+ * whitened first.
+ * */
+
+struct Witness {
+    using point_t = point_max;
+
+    enum class Landmarks {
+        MaxMin,
+        Random,
+    };
+
+    Witness(std::span<const point_t> points, Metric metric = Metric::Euclidean) : points(points), metric(metric) {
+
+    }
+
+    const std::span<const point_t> points;
+    const Metric metric;
+
+    // select (at most) count landmark indices, either by farthest point (maxmin) sampling or uniformly at random
+    std::vector<i32> SelectLandmarks(size_t count, Landmarks method, u32 seed = 0) const;
+
+    // find the squared lazy witness edge values between all landmarks as a dense row-major matrix
+    // values are in the same units as Compute::Distance2, so they are compared against 4 * epsilon * epsilon
+    // edges that only appear after max_epsilon are stored as infinity
+    std::vector<float> FindLazyWitnessDistances(const std::vector<i32>& landmarks, int nu, float max_epsilon) const;
+
+private:
+    template<Metric M>
+    std::vector<float> FindLazyWitnessDistancesImpl(const std::vector<i32>& landmarks, int nu, float max_epsilon) const;
+
+    template<Metric M>
+    std::vector<i32> SelectMaxMin(size_t count, u32 seed) const;
+    std::vector<i32> SelectRandom(size_t count, u32 seed) const;
+};
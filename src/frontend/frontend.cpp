@@ -16,7 +16,9 @@ constexpr float pi = 3.14159265;
 
 Frontend::Frontend(std::unique_ptr<ComputeBase>&& _compute) :
         compute(std::move(_compute)),
-        no_vertices{compute->points.size()} {
+        // nothing is drawn until the first simplex buffers are received
+        no_vertices{},
+        scheduler(*compute, NumChannels) {
 
 }
 
@@ -82,10 +84,6 @@ void Frontend::InitOGL() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(point_t), nullptr);
     glEnableVertexAttribArray(0);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo[0]);
-    std::vector<i32> indices = compute->FindSimplexDrawIndices(0, 0)[0];
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(i32) * indices.size(), indices.data(), GL_STATIC_DRAW);
-
     glEnable(GL_PROGRAM_POINT_SIZE);
     glEnable(GL_POINT_SMOOTH);
     glEnable(GL_BLEND);
@@ -93,6 +91,9 @@ void Frontend::InitOGL() {
     glEnable(GL_DEPTH_TEST);
 
     glBindVertexArray(0);
+
+    // the initial simplices may exceed the memory budget too, so they are found like any other
+    FindSimplexIndices();
 }
 
 void Frontend::InitImGui() {
@@ -161,71 +162,70 @@ void Frontend::HandleInput() {
 }
 
 void Frontend::DrawMenu() {
-    ImGui::SetNextWindowSize(ImVec2{400, 200}, ImGuiCond_Always);
+    ImGui::SetNextWindowSize(ImVec2{400, 260}, ImGuiCond_Always);
     if (!ImGui::Begin("Menu", &menu_open, ImGuiWindowFlags_NoResize)) {
         ImGui::End();
         return;
     }
 
-    bool disabled = simplex_indices_future.valid() || h_basis_future.valid();
-
-    if (disabled) ImGui::BeginDisabled();
+    // the controls stay enabled while computing, a new request replaces the one that is running
     const char* dimension_items[] = {"0-dimensional", "1-dimensional", "2-dimensional", "3-dimensional"};
     auto old_dim = dimension;
     if (ImGui::Combo("dimension", &dimension, dimension_items, IM_ARRAYSIZE(dimension_items))) {
         if (old_dim != dimension) {
-            // reset h basis (no longer valid)
-            h_basis_vertices = 0;
-            h_basis_size = 0;
-            show_homology = false;
-
-            // start computation for simplex indices
-            start = std::chrono::steady_clock::now();
-            simplex_indices_future = std::async(
-                    std::launch::async, &ComputeBase::FindSimplexDrawIndices, compute.get(), epsilon, dimension
-            );
+            // reset homology bars (no longer valid)
+            ResetHomologyBars();
+
+            FindSimplexIndices();
         }
     }
     if (ImGui::SliderFloat("epsilon", &epsilon, 0, 5, "%.4f", ImGuiSliderFlags_Logarithmic)) {
-        // reset h basis (no longer valid)
-        h_basis_vertices = 0;
-        h_basis_size = 0;
-        show_homology = false;
-
-        start = std::chrono::steady_clock::now();
-        simplex_indices_future = std::async(
-                std::launch::async, &ComputeBase::FindSimplexDrawIndices, compute.get(), epsilon, dimension
-        );
+        if (homology && epsilon <= homology->max_epsilon) {
+            SelectHomologyBars();
+        }
+        else if (!pending_homology || epsilon > *pending_homology) {
+            // reset homology bars (no longer valid)
+            // bars that are still computed up to this epsilon are kept, they are selected for it when they arrive
+            ResetHomologyBars();
+        }
+
+        FindSimplexIndices();
     }
 
     if (dimension > 0) {
         if (ImGui::Button(("homology H" + std::to_string(dimension - 1)).c_str())) {
-            homology_dim = dimension - 1;
-            h_basis_size = 0;
-            h_basis_vertices = 0;
-
-            start = std::chrono::steady_clock::now();
-            h_basis_future = std::async(std::launch::async, &ComputeBase::FindHBasisDrawIndices, compute.get(), epsilon, homology_dim);
+            FindHomologyBars();
         }
 
         ImGui::SameLine();
         ImGui::Text("dim(H%d) = %lld", homology_dim, h_basis_size);
-        if (h_basis_vertices) {
+        if (!h_counts.empty()) {
             ImGui::SameLine();
             if (ImGui::Checkbox("show homology", &show_homology)) {
 
             }
         }
     }
-    if (disabled) ImGui::EndDisabled();
 
-    if (!simplex_indices_future.valid() && !h_basis_future.valid()) {
-        ImGui::Text("%d %d-simplices", compute->current_simplices, dimension);
+    if (!scheduler.Busy()) {
+        ImGui::Text("%zu %d-simplices", simplex_count, dimension);
         ImGui::Text("%lldms elapsed", std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
     }
     else {
-        ImGui::Text("%d simplices", compute->current_simplices);
+        const auto& progress = compute->progress;
+        ImGui::Text(
+                "%s (dimension %d): %llu / %llu", Progress::PhaseName(progress.phase.load()), progress.dim.load(),
+                (unsigned long long)progress.done.load(), (unsigned long long)progress.total.load()
+        );
         ImGui::Text("%lldms elapsed", std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+        ImGui::SameLine();
+        if (ImGui::Button("cancel")) {
+            scheduler.Cancel();
+        }
+    }
+
+    if (!error_message.empty()) {
+        ImGui::TextWrapped("%s", error_message.c_str());
     }
 
     // allow different coordinate projections
@@ -240,46 +240,152 @@ void Frontend::DrawMenu() {
     ImGui::End();
 }
 
-void Frontend::CheckSimplexIndexCommand() {
-    if (!simplex_indices_future.valid()) {
+void Frontend::FindSimplexIndices() {
+    error_message.clear();
+    if (dimension < buffers.values.size() && epsilon <= buffers.max_epsilon) {
+        // the simplices are a prefix of the buffers, so a larger buffer that is still computed is not needed anymore
+        scheduler.Drop(SimplexIndices);
+        CountSimplices();
+        duration = std::chrono::milliseconds(0);
         return;
     }
-    if (simplex_indices_future.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+
+    start = std::chrono::steady_clock::now();
+    scheduler.Submit(
+            SimplexIndices,
+            [compute = compute.get(), epsilon = epsilon, dimension = dimension] {
+                return compute->FindSimplexDrawBuffers(epsilon, dimension);
+            },
+            [this](auto result) { ReceiveSimplexBuffers(std::move(result)); }
+    );
+}
+
+void Frontend::ReceiveSimplexBuffers(std::future<ComputeBase::DrawBuffers> result) {
+    ComputeBase::DrawBuffers received;
+    try {
+        received = result.get();
+    }
+    catch (BudgetExceeded& e) {
+        // keep showing the previous simplices
+        error_message = e.what();
+        return;
+    }
+    catch (Cancelled& e) {
+        error_message = e.what();
+        return;
+    }
+    catch (std::exception& e) {
+        error_message = e.what();
         return;
     }
-
-    auto indices = simplex_indices_future.get();
     duration = std::chrono::steady_clock::now() - start;
+    UploadSimplexBuffers(std::move(received));
+}
 
+void Frontend::UploadSimplexBuffers(ComputeBase::DrawBuffers received) {
+    glBindVertexArray(vao);
+    for (int i = 0; i < received.indices.size(); i++) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo[i]);
+        glBufferData(
+                GL_ELEMENT_ARRAY_BUFFER, sizeof(i32) * received.indices[i].size(), received.indices[i].data(),
+                GL_STATIC_DRAW
+        );
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // only the values are needed to count the simplices at an epsilon
+    received.indices.clear();
+    buffers = std::move(received);
+    CountSimplices();
+}
+
+void Frontend::CountSimplices() {
     // clear out number of vertices
     no_vertices = {};
-    for (int i = 0; i < indices.size(); i++) {
-        no_vertices[i] = indices[i].size();
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo[i]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(i32) * no_vertices[i], indices[i].data(), GL_STATIC_DRAW);
+    for (int i = 0; i < no_vertices.size() && i < buffers.values.size() && i <= dimension; i++) {
+        no_vertices[i] = (i + 1) * buffers.Count(i, epsilon);
     }
+    simplex_count = dimension < buffers.values.size() ? buffers.Count(dimension, epsilon) : 0;
 }
 
 
-void Frontend::CheckHomologyBasisCommand() {
-    if (!h_basis_future.valid()) {
+void Frontend::FindHomologyBars() {
+    ResetHomologyBars();
+    homology_dim = dimension - 1;
+
+    // the simplices up to buffers.max_epsilon were already found (and fit in the memory budget), so we find the bars
+    // up to there, and the homology can be drawn at any epsilon the simplices can
+    float max_epsilon = epsilon;
+    if (dimension < buffers.values.size()) {
+        max_epsilon = std::max(max_epsilon, buffers.max_epsilon);
+    }
+
+    error_message.clear();
+    start = std::chrono::steady_clock::now();
+    pending_homology = max_epsilon;
+    scheduler.Submit(
+            HomologyBasis,
+            [compute = compute.get(), max_epsilon = max_epsilon, homology_dim = homology_dim] {
+                return compute->FindHomologyBars(max_epsilon, homology_dim);
+            },
+            [this](auto result) { ReceiveHomologyBars(std::move(result)); }
+    );
+}
+
+void Frontend::ReceiveHomologyBars(std::future<ComputeBase::HomologyBars> result) {
+    ComputeBase::HomologyBars bars;
+    pending_homology.reset();
+    try {
+        bars = result.get();
+    }
+    catch (BudgetExceeded& e) {
+        error_message = e.what();
         return;
     }
-    if (h_basis_future.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+    catch (Cancelled& e) {
+        error_message = e.what();
+        return;
+    }
+    catch (std::exception& e) {
+        error_message = e.what();
         return;
     }
-
-    auto [h_basis_size_, h_basis] = h_basis_future.get();
     duration = std::chrono::steady_clock::now() - start;
 
-    h_basis_size = h_basis_size_;
-    h_basis_vertices = h_basis.size();
-
     glBindVertexArray(vao);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, hebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(i32) * h_basis_vertices, h_basis.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(i32) * bars.indices.size(), bars.indices.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
+
+    // only the bars and offsets are needed to select the cycles at an epsilon
+    bars.indices.clear();
+    homology = std::move(bars);
+    SelectHomologyBars();
+}
+
+void Frontend::SelectHomologyBars() {
+    h_counts.clear();
+    h_offsets.clear();
+    for (size_t k = 0; k < homology->bars.size(); k++) {
+        if (homology->Alive(k, epsilon)) {
+            const size_t offset = homology->offsets[k];
+            h_counts.push_back(homology->offsets[k + 1] - offset);
+            h_offsets.push_back((const void*)(sizeof(i32) * offset));
+        }
+    }
+    h_basis_size = h_counts.size();
+}
+
+void Frontend::ResetHomologyBars() {
+    homology.reset();
+    pending_homology.reset();
+    h_basis_size = 0;
+    h_counts.clear();
+    h_offsets.clear();
+    show_homology = false;
+    scheduler.Drop(HomologyBasis);
 }
 
 void Frontend::Run() {
@@ -298,8 +404,8 @@ void Frontend::Run() {
         ImGui_ImplSDL2_NewFrame((SDL_Window*)window);
         ImGui::NewFrame();
 
-        CheckSimplexIndexCommand();
-        CheckHomologyBasisCommand();
+        // upload the simplices or homology basis that were computed since the last frame
+        scheduler.Poll();
         DrawMenu();
 
         // ImGui example window
@@ -336,7 +442,9 @@ void Frontend::Run() {
         else {
             glUniform1f(alpha, 1.0);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, hebo);
-            glDrawElements(draw_type[homology_dim], h_basis_vertices, GL_UNSIGNED_INT, nullptr);
+            glMultiDrawElements(
+                    draw_type[homology_dim], h_counts.data(), GL_UNSIGNED_INT, h_offsets.data(), h_counts.size()
+            );
 
             if (homology_dim < 2) {
                 static constexpr float alpha_values[] = { 0.3, 0.05 };
@@ -3,10 +3,13 @@
 #include "camera.h"
 #include "default.h"
 #include "compute/compute.h"
+#include "compute/scheduler.h"
 
 #include <future>
+#include <string>
 #include <optional>
 #include <chrono>
+#include <vector>
 #include <boost/container/static_vector.hpp>
 
 
@@ -55,16 +58,47 @@ private:
     std::array<size_t, 3> no_vertices;
     std::chrono::time_point<std::chrono::steady_clock> start;
     std::chrono::duration<double> duration = std::chrono::milliseconds(0);
-    std::future<boost::container::static_vector<std::vector<i32>, 3>> simplex_indices_future{};
-    void CheckSimplexIndexCommand();
+
+    // the element buffers hold the simplices up to buffers.max_epsilon in filtration order, so at any smaller epsilon
+    // we only draw fewer of them, found by a binary search in their values (the indices are only on the gpu)
+    ComputeBase::DrawBuffers buffers{};
+    size_t simplex_count = 0;
+    void FindSimplexIndices();
+    void ReceiveSimplexBuffers(std::future<ComputeBase::DrawBuffers> result);
+    void UploadSimplexBuffers(ComputeBase::DrawBuffers received);
+    // set the amount of vertices to draw for the current epsilon and dimension
+    void CountSimplices();
 
 
     using point_t = typename ComputeBase::point_t;
 
+    // the cycles of all bars up to homology->max_epsilon are in hebo, so at any smaller epsilon we only draw the cycles
+    // of the bars that are alive (the indices are only on the gpu)
     int homology_dim = 0;
     bool show_homology = false;
+    std::optional<ComputeBase::HomologyBars> homology{};
+    // max_epsilon of the bars that are still computed, they are kept while epsilon stays below it
+    std::optional<float> pending_homology{};
     size_t h_basis_size = 0;
-    size_t h_basis_vertices = 0;
-    std::future<std::pair<size_t, std::vector<i32>>> h_basis_future{};
-    void CheckHomologyBasisCommand();
+    // amount of indices and (byte) offsets into hebo of the cycles of the bars that are alive at epsilon
+    std::vector<i32> h_counts{};
+    std::vector<const void*> h_offsets{};
+    void FindHomologyBars();
+    void ReceiveHomologyBars(std::future<ComputeBase::HomologyBars> result);
+    // select the bars that are alive at the current epsilon
+    void SelectHomologyBars();
+    void ResetHomologyBars();
+
+    // message of the last job that was refused (for exceeding the memory budget) or cancelled
+    std::string error_message{};
+
+    // the simplices can be found while a homology basis is computed
+    enum Channel {
+        SimplexIndices,
+        HomologyBasis,
+        NumChannels,
+    };
+
+    // runs the computations off the render loop, destroyed (and so stopped) before compute
+    Scheduler scheduler;
 };
\ No newline at end of file